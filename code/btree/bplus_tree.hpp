@@ -0,0 +1,292 @@
+#ifndef BPLUS_TREE_HPP
+#define BPLUS_TREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <vector>
+
+namespace b {
+
+// node of a B+-tree: internal nodes hold separators, leaves hold every key
+// and are linked to their right sibling
+template <typename T>
+struct bplus_node {
+  bplus_node(const int t, const bool leaf) : t(t), leaf(leaf), next(nullptr) {
+    keys.reserve(2 * t - 1);
+    if (!leaf) children.reserve(2 * t);
+  }
+
+  ~bplus_node() {
+    const int len = children.size();
+    for (int i = 0; i < len; i++) delete children[i];
+  }
+
+  void split_child(const int i) {
+    bplus_node<T>* left = children[i];
+    bplus_node<T>* right = new bplus_node<T>(t, left->leaf);
+    children.insert(children.begin() + i + 1, right);
+
+    if (left->leaf) {
+      // copy upper keys to right leaf and its first key up as separator
+      std::copy(left->keys.begin() + t, left->keys.end(),
+                std::back_inserter(right->keys));
+      left->keys.erase(left->keys.begin() + t, left->keys.end());
+      keys.insert(keys.begin() + i, right->keys[0]);
+
+      // link right leaf after left
+      right->next = left->next;
+      left->next = right;
+    } else {
+      // copy keys and children to right child
+      std::copy(left->keys.begin() + t, left->keys.end(),
+                std::back_inserter(right->keys));
+      std::copy(left->children.begin() + t, left->children.end(),
+                std::back_inserter(right->children));
+      left->keys.erase(left->keys.begin() + t, left->keys.end());
+      left->children.erase(left->children.begin() + t, left->children.end());
+
+      // move median up
+      keys.insert(keys.begin() + i, left->keys[t - 1]);
+      left->keys.pop_back();
+    }
+  }
+
+  bool insert(const T& key) {
+    // keys equal to a separator live to its right
+    typename std::vector<T>::iterator it =
+        std::upper_bound(keys.begin(), keys.end(), key);
+
+    if (leaf) {
+      if (it != keys.begin() && *(it - 1) == key) return false;
+      keys.insert(it, key);
+      return true;
+    }
+
+    // find proper child, splitting it if full
+    int i = it - keys.begin();
+    if ((int)children[i]->keys.size() == 2 * t - 1) {
+      split_child(i);
+
+      // find out which of the new children is proper
+      if (!(key < keys[i])) i++;
+    }
+
+    return children[i]->insert(key);
+  }
+
+  void merge_right_left(const int i) {
+    bplus_node<T>* left = children[i];
+    bplus_node<T>* right = children[i + 1];
+
+    if (left->leaf) {
+      // separator is dropped, leaves are concatenated
+      left->next = right->next;
+    } else {
+      // descend separator to be new median
+      left->keys.push_back(keys[i]);
+      std::copy(right->children.begin(), right->children.end(),
+                std::back_inserter(left->children));
+    }
+    std::copy(right->keys.begin(), right->keys.end(),
+              std::back_inserter(left->keys));
+    keys.erase(keys.begin() + i);
+
+    // delete pointer to right child
+    // prevent recursive deletion of its children
+    right->children.clear();
+    delete right;
+    children.erase(children.begin() + i + 1);
+  }
+
+  bool erase(const T& key) {
+    if (leaf) {
+      typename std::vector<T>::iterator it =
+          std::lower_bound(keys.begin(), keys.end(), key);
+      if (it == keys.end() || *it != key) return false;
+      keys.erase(it);
+      return true;
+    }
+
+    int i = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+    bplus_node<T>* child = children[i];
+
+    // maintain every node with at least t keys while recursing down the tree
+    if ((int)child->keys.size() < t) {
+      if (i < (int)keys.size() && (int)children[i + 1]->keys.size() >= t) {
+        bplus_node<T>* right = children[i + 1];
+        if (child->leaf) {
+          // move right sibling's leftmost key, which becomes separator
+          child->keys.push_back(right->keys[0]);
+          right->keys.erase(right->keys.begin());
+          keys[i] = right->keys[0];
+        } else {
+          // rotate through separator, moving right sibling's leftmost child
+          child->keys.push_back(keys[i]);
+          keys[i] = right->keys[0];
+          right->keys.erase(right->keys.begin());
+          child->children.push_back(right->children[0]);
+          right->children.erase(right->children.begin());
+        }
+
+      } else if (i > 0 && (int)children[i - 1]->keys.size() >= t) {
+        bplus_node<T>* left = children[i - 1];
+        if (child->leaf) {
+          // move left sibling's rightmost key, which becomes separator
+          child->keys.insert(child->keys.begin(), left->keys.back());
+          left->keys.pop_back();
+          keys[i - 1] = child->keys[0];
+        } else {
+          // rotate through separator, moving left sibling's rightmost child
+          child->keys.insert(child->keys.begin(), keys[i - 1]);
+          keys[i - 1] = left->keys.back();
+          left->keys.pop_back();
+          child->children.insert(child->children.begin(),
+                                 left->children.back());
+          left->children.pop_back();
+        }
+
+      } else if (i < (int)keys.size()) {
+        merge_right_left(i);
+      } else {
+        merge_right_left(--i);
+      }
+    }
+
+    return children[i]->erase(key);
+  }
+
+  void print(std::ostream& stream, const int level) const {
+    for (int i = 0; i < level; i++) stream << " ";
+    stream << "[";
+    int n = keys.size();
+    for (int i = 0; i < n; i++) {
+      stream << keys[i];
+      if (i < n - 1) stream << " ";
+    }
+    n = children.size();
+    stream << "]" << std::endl;
+    for (int i = 0; i < n; i++) children[i]->print(stream, level + 1);
+  }
+
+  const int t;
+  const bool leaf;
+  std::vector<T> keys;
+  std::vector<bplus_node<T>*> children;
+  bplus_node<T>* next;
+};
+
+template <typename T>
+class bplus_tree {
+ public:
+  // forward iterator over the linked leaves
+  class iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    iterator() : leaf(nullptr), i(0) {}
+    iterator(const bplus_node<T>* leaf, const int i) : leaf(leaf), i(i) {
+      skip_exhausted();
+    }
+
+    const T& operator*() const { return leaf->keys[i]; }
+    const T* operator->() const { return &leaf->keys[i]; }
+
+    iterator& operator++() {
+      i++;
+      skip_exhausted();
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator ret = *this;
+      ++*this;
+      return ret;
+    }
+
+    bool operator==(const iterator& other) const {
+      return leaf == other.leaf && i == other.i;
+    }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+
+   private:
+    const bplus_node<T>* leaf;
+    int i;
+
+    void skip_exhausted() {
+      while (leaf && i == (int)leaf->keys.size()) {
+        leaf = leaf->next;
+        i = 0;
+      }
+    }
+  };
+
+  bplus_tree(const int t) : t(t) { root = new bplus_node<T>(t, true); }
+
+  ~bplus_tree() { delete root; }
+
+  bool search(const T& key) const {
+    iterator it = lower_bound(key);
+    return it != end() && *it == key;
+  }
+
+  bool insert(const T& key) {
+    // if root is full, create new root and split old root
+    if ((int)root->keys.size() == 2 * t - 1) {
+      bplus_node<T>* r = root;
+      root = new bplus_node<T>(t, false);
+      root->children.push_back(r);
+      root->split_child(0);
+    }
+
+    return root->insert(key);
+  }
+
+  bool erase(const T& key) {
+    const bool erased = root->erase(key);
+
+    // if root is emptied by deletion, make left child new root
+    if (root->keys.empty() && !root->leaf) {
+      bplus_node<T>* new_root = root->children[0];
+      root->children.clear();
+      delete root;
+      root = new_root;
+    }
+
+    return erased;
+  }
+
+  iterator lower_bound(const T& key) const {
+    // keys equal to a separator live to its right
+    const bplus_node<T>* x = root;
+    while (!x->leaf)
+      x = x->children[std::upper_bound(x->keys.begin(), x->keys.end(), key) -
+                      x->keys.begin()];
+
+    return iterator(
+        x, std::lower_bound(x->keys.begin(), x->keys.end(), key) -
+               x->keys.begin());
+  }
+
+  iterator begin() const {
+    const bplus_node<T>* x = root;
+    while (!x->leaf) x = x->children[0];
+    return iterator(x, 0);
+  }
+
+  iterator end() const { return iterator(); }
+
+  void print(std::ostream& stream) const { root->print(stream, 0); }
+
+ private:
+  const int t;
+  bplus_node<T>* root;
+};
+}
+
+#endif
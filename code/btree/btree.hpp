@@ -2,24 +2,101 @@
 #define BTREE_HPP
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 
 namespace b {
 
+// binary image of a b::tree: this header, an entry for each node in level
+// order, then the keys of every node in the same order
+// children of a node are consecutive entries, so the image holds no pointers
+// and can be searched where it lies, as b::image does
+struct image_header {
+  char magic[4];
+  std::uint32_t version, key_size, t;
+  std::uint64_t n_nodes, n_keys;
+
+  // IMAGE_BYTE_ORDER, which reads differently on machines of other endianness
+  std::uint64_t byte_order;
+  std::uint8_t reserved[24];
+};
+
+struct image_node {
+  // offset of the node's first key and index of its first child, 0 if leaf
+  std::uint64_t keys, children;
+
+  // number of keys in subtree
+  std::uint64_t size;
+  std::uint32_t n, reserved;
+};
+
+const char IMAGE_MAGIC[4] = {'B', 'T', 'I', 'M'};
+const std::uint32_t IMAGE_VERSION = 1;
+const std::uint64_t IMAGE_BYTE_ORDER = 0x0102030405060708ULL;
+
+inline void check_image_header(const image_header& header,
+                               const std::size_t key_size) {
+  if (std::memcmp(header.magic, IMAGE_MAGIC, sizeof header.magic))
+    throw std::runtime_error("Not a b::tree image");
+  if (header.byte_order != IMAGE_BYTE_ORDER)
+    throw std::runtime_error("Image written with another byte order");
+  if (header.version != IMAGE_VERSION)
+    throw std::runtime_error("Unexpected image version. Expected version " +
+                             std::to_string(IMAGE_VERSION) + " and got " +
+                             std::to_string(header.version));
+  if (header.key_size != key_size)
+    throw std::runtime_error("Unexpected key size. Expected size " +
+                             std::to_string(key_size) + " and got " +
+                             std::to_string(header.key_size));
+}
+
 template <typename T>
 struct node {
-  node(const int t) : t(t) {
+  node(const int t) : t(t), size(0), refs(1) {
     keys.reserve(t);
     children.reserve(t);
   }
 
   ~node() {
-    const int len = children.size();
-    for (int i = 0; i < len; i++) delete children[i];
+    for (node<T>* child : children) release(child);
+  }
+
+  static void release(node<T>* x) {
+    // drop a reference, deleting the node with the last one
+    if (x->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete x;
+  }
+
+  static node<T>* owned(node<T>* x) {
+    // nodes shared with a snapshot are copied before being modified
+    if (x->refs.load(std::memory_order_acquire) == 1) return x;
+
+    node<T>* copy = new node<T>(x->t);
+    copy->size = x->size;
+    copy->keys = x->keys;
+    copy->children = x->children;
+    for (node<T>* child : copy->children)
+      child->refs.fetch_add(1, std::memory_order_relaxed);
+    release(x);
+    return copy;
+  }
+
+  node<T>* own(const int i) {
+    // make child i safe to modify
+    return children[i] = owned(children[i]);
   }
 
   void split_child(const int i) {
+    own(i);
+
     // create right child
     node<T>* right = new node<T>(t);
     children.insert(children.begin() + i + 1, right);
@@ -40,9 +117,16 @@ struct node {
     // move median up
     keys.insert(keys.begin() + i, children[i]->keys[t - 1]);
     children[i]->keys.pop_back();
+
+    // split subtree sizes
+    right->size = right->keys.size();
+    for (node<T>* child : right->children) right->size += child->size;
+    children[i]->size -= right->size + 1;
   }
 
   void insert(const T& key) {
+    size++;
+
     // if leaf, insert in it
     // otherwise, continue insertion downwards
     if (children.empty()) {
@@ -57,10 +141,10 @@ struct node {
       typename std::vector<T>::iterator it =
           std::upper_bound(keys.begin(), keys.end(), key);
       int i = it - keys.begin();
-      node<T>* child = children[i];
+      node<T>* child = own(i);
 
       // if proper child is full, split it
-      if (child->keys.size() == 2 * t - 1) {
+      if ((int)child->keys.size() == 2 * t - 1) {
         split_child(i);
 
         // find out which of the new children is proper
@@ -87,9 +171,13 @@ struct node {
   }
 
   void merge_right_left(const int i) {
+    own(i);
+    own(i + 1);
+
     // descend ith-key to be new median
     children[i]->keys.push_back(keys[i]);
     keys.erase(keys.begin() + i);
+    children[i]->size += children[i + 1]->size + 1;
 
     // append the keys and children of the right child to left's
     std::copy(children[i + 1]->keys.begin(), children[i + 1]->keys.end(),
@@ -106,25 +194,33 @@ struct node {
     children.erase(children.begin() + i + 1);
   }
 
-  void erase(const T& key) {
+  bool erase(const T& key) {
+    /* returns: whether key was found */
+
     typename std::vector<T>::iterator it =
         std::lower_bound(keys.begin(), keys.end(), key);
     const int i = it - keys.begin();
+    bool erased = false;
 
     if (it != keys.end() && *it == key) {
+      erased = true;
       if (children.empty()) {
         // if leaf, just erase it
         keys.erase(it);
-      } else if (children[i]->keys.size() >= t) {
-        // get key from child left of key
-        const T replacement = children[i]->keys.back();
-        children[i]->erase(replacement);
+      } else if ((int)children[i]->keys.size() >= t) {
+        // replace key by its predecessor, the rightmost key below left child
+        node<T>* x = children[i];
+        while (!x->children.empty()) x = x->children.back();
+        const T replacement = x->keys.back();
+        own(i)->erase(replacement);
         *it = replacement;
 
-      } else if (children[i + 1]->keys.size() >= t) {
-        // get key from child right of key
-        const T replacement = children[i + 1]->keys[0];
-        children[i + 1]->erase(replacement);
+      } else if ((int)children[i + 1]->keys.size() >= t) {
+        // replace key by its successor, the leftmost key below right child
+        node<T>* x = children[i + 1];
+        while (!x->children.empty()) x = x->children[0];
+        const T replacement = x->keys[0];
+        own(i + 1)->erase(replacement);
         *it = replacement;
 
       } else {
@@ -137,10 +233,13 @@ struct node {
       if (!children.empty()) {
         // maintain every node with at lest t keys
         // while recursing down the tree
-        if (children[i]->keys.size() >= t)
-          children[i]->erase(key);
+        if ((int)children[i]->keys.size() >= t)
+          erased = own(i)->erase(key);
         else {
-          if (it != keys.end() && children[i + 1]->keys.size() >= t) {
+          if (it != keys.end() && (int)children[i + 1]->keys.size() >= t) {
+            own(i);
+            own(i + 1);
+
             // descend a key from current node to recursion node
             children[i]->keys.push_back(*it);
 
@@ -149,17 +248,24 @@ struct node {
             std::swap(children[i + 1]->keys[0], *it);
             children[i + 1]->keys.erase(children[i + 1]->keys.begin());
 
+            int moved = 1;
             if (!children[i]->children.empty()) {
               // move right sibiling's leftmost child to recursion node
               children[i]->children.push_back(children[i + 1]->children[0]);
               children[i + 1]->children.erase(
                   children[i + 1]->children.begin());
+              moved += children[i]->children.back()->size;
             }
+            children[i]->size += moved;
+            children[i + 1]->size -= moved;
 
             // continue recursive deletion
-            children[i]->erase(key);
+            erased = children[i]->erase(key);
+
+          } else if (i > 0 && (int)children[i - 1]->keys.size() >= t) {
+            own(i);
+            own(i - 1);
 
-          } else if (i > 0 && children[i - 1]->keys.size() >= t) {
             // descend a key from current node to recursion node
             children[i]->keys.insert(children[i]->keys.begin(), *(it - 1));
 
@@ -168,15 +274,19 @@ struct node {
             std::swap(children[i - 1]->keys.back(), *(it - 1));
             children[i - 1]->keys.pop_back();
 
+            int moved = 1;
             if (!children[i]->children.empty()) {
               // move left sibiling's rightmost child to recursion node
               children[i]->children.insert(children[i]->children.begin(),
                                            children[i - 1]->children.back());
               children[i - 1]->children.pop_back();
+              moved += children[i]->children[0]->size;
             }
+            children[i]->size += moved;
+            children[i - 1]->size -= moved;
 
             // continue recursive deletion
-            children[i]->erase(key);
+            erased = children[i]->erase(key);
 
           } else if (it != keys.end()) {
             // merge recursion node with its right sibiling,
@@ -184,7 +294,7 @@ struct node {
             merge_right_left(i);
 
             // continue recursive deletion
-            children[i]->erase(key);
+            erased = children[i]->erase(key);
 
           } else if (i > 0) {
             // merge recursion node with its left sibiling
@@ -192,11 +302,94 @@ struct node {
             merge_right_left(i - 1);
 
             // continue recursive deletion
-            children[i - 1]->erase(key);
+            erased = children[i - 1]->erase(key);
           }
         }
       }
     }
+
+    if (erased) size--;
+    return erased;
+  }
+
+  int rank(const T& key) const {
+    /* returns: number of keys smaller than 'key' */
+
+    int ret = 0;
+    const node<T>* x = this;
+    for (;;) {
+      const int i = std::lower_bound(x->keys.begin(), x->keys.end(), key) -
+                    x->keys.begin();
+      ret += i;
+      if (x->children.empty()) return ret;
+
+      // keys left of i and their subtrees are smaller
+      for (int j = 0; j < i; j++) ret += x->children[j]->size;
+      x = x->children[i];
+    }
+  }
+
+  const T& select(int k) const {
+    /* returns: kth smallest key, counting from 0 */
+
+    if (k < 0 || k >= size)
+      throw std::out_of_range("No key of rank " + std::to_string(k));
+
+    const node<T>* x = this;
+    for (;;) {
+      if (x->children.empty()) return x->keys[k];
+
+      // skip whole subtrees and the keys after them until k falls in one
+      int i = 0;
+      while (k > x->children[i]->size) {
+        k -= x->children[i]->size + 1;
+        i++;
+      }
+      if (k == x->children[i]->size) return x->keys[i];
+      x = x->children[i];
+    }
+  }
+
+  void split_overflowing_child(const int i) {
+    // split child i holding 2t keys, which keeps t of them, moving its
+    // median up
+    node<T>* left = own(i);
+    node<T>* right = new node<T>(t);
+    right->keys.assign(left->keys.begin() + t + 1, left->keys.end());
+    if (!left->children.empty()) {
+      right->children.assign(left->children.begin() + t + 1,
+                             left->children.end());
+      left->children.erase(left->children.begin() + t + 1,
+                           left->children.end());
+    }
+    keys.insert(keys.begin() + i, left->keys[t]);
+    children.insert(children.begin() + i + 1, right);
+    left->keys.erase(left->keys.begin() + t, left->keys.end());
+    left->update_size();
+    right->update_size();
+  }
+
+  void update_size() {
+    // recompute size from own keys and children's sizes
+    size = keys.size();
+    for (node<T>* child : children) size += child->size;
+  }
+
+  int recount() {
+    // recompute subtree sizes below this node
+    size = keys.size();
+    for (node<T>* child : children) size += child->recount();
+    return size;
+  }
+
+  void collect(std::vector<T>& ret) const {
+    // append keys in order
+    const int n = keys.size();
+    for (int i = 0; i < n; i++) {
+      if (!children.empty()) children[i]->collect(ret);
+      ret.push_back(keys[i]);
+    }
+    if (!children.empty()) children.back()->collect(ret);
   }
 
   void print(std::ostream& stream, const int level) const {
@@ -213,16 +406,60 @@ struct node {
   }
 
   const int t;
+
+  // number of keys in the subtree rooted at this node
+  int size;
+
+  // the tree and snapshots holding this node
+  std::atomic<int> refs;
+
   std::vector<T> keys;
   std::vector<node<T>*> children;
 };
 
+// immutable view of a b::tree as it was when taken
+// it shares nodes with the tree, which copies every shared node before
+// modifying it, so snapshots can be read and released from other threads
+// while the tree keeps changing
+template <typename T>
+class snapshot {
+ public:
+  explicit snapshot(node<T>* root) : root(root) {
+    root->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  snapshot(const snapshot& other) : snapshot(other.root) {}
+
+  snapshot& operator=(const snapshot& other) {
+    snapshot copy(other);
+    std::swap(root, copy.root);
+    return *this;
+  }
+
+  ~snapshot() { node<T>::release(root); }
+
+  bool search(const T& key) const { return root->search(key); }
+
+  int size() const { return root->size; }
+
+  int rank(const T& key) const { return root->rank(key); }
+
+  const T& select(const int k) const { return root->select(k); }
+
+  void collect(std::vector<T>& ret) const { root->collect(ret); }
+
+  void print(std::ostream& stream) const { root->print(stream, 0); }
+
+ private:
+  node<T>* root;
+};
+
 template <typename T>
 class tree {
  public:
   tree(const int t) : t(t) { root = new node<T>(t); }
 
-  ~tree() { delete root; }
+  ~tree() { node<T>::release(root); }
 
   bool search(const T& key) const {
     typename std::vector<T>::iterator it =
@@ -240,32 +477,526 @@ class tree {
 
   void insert(const T& key) {
     // if root is full, create new root and split old root
-    if (root->keys.size() == 2 * t - 1) {
+    if ((int)root->keys.size() == 2 * t - 1) {
       node<T>* r = root;
       root = new node<T>(t);
+      root->size = r->size;
       root->children.push_back(r);
       root->split_child(0);
     }
 
+    root = node<T>::owned(root);
     root->insert(key);
   }
 
   void erase(const T& key) {
+    root = node<T>::owned(root);
     root->erase(key);
-    // if root is emptied by deletion, make left child new root
-    if (root->keys.empty() && !root->children.empty()) {
-      node<T>* new_root = root->children[0];
-      root->children.clear();
-      delete root;
-      root = new_root;
+    shrink(root);
+  }
+
+  int erase_range(const T& lo, const T& hi) {
+    /* erases every key in [lo, hi) by splitting the tree around the range
+    and joining the outer parts back.
+    - returns: number of keys erased */
+
+    if (!(lo < hi)) return 0;
+
+    node<T>* left;
+    node<T>* middle;
+    node<T>* right;
+    split(root, lo, left, right);
+    split(right, hi, middle, right);
+    const int erased = middle->size;
+    node<T>::release(middle);
+
+    // join outer parts around the smallest key right of the range
+    if (!right->size) {
+      node<T>::release(right);
+      root = left;
+    } else {
+      const node<T>* x = right;
+      while (!x->children.empty()) x = x->children[0];
+      const T separator = x->keys[0];
+      right = node<T>::owned(right);
+      right->erase(separator);
+      shrink(right);
+      root = join(left, separator, right);
     }
+
+    return erased;
   }
 
+  template <typename Iterator>
+  void insert_sorted(Iterator begin, Iterator end) {
+    // insert sorted range [begin, end), resuming each descent from the
+    // deepest node on the previous key's path whose range holds the key
+    // sizes of nodes on the path are brought up to date as they are left
+    root = node<T>::owned(root);
+    std::vector<node<T>*> path(1, root);
+
+    // child taken below each internal node of the path
+    std::vector<int> index;
+
+    // key bounding each node of the path from above, if any
+    std::vector<const T*> bounds(1, nullptr);
+
+    for (Iterator it = begin; it != end; ++it) {
+      const T& key = *it;
+      while (bounds.back() && !(key < *bounds.back())) {
+        path.back()->update_size();
+        path.pop_back();
+        bounds.pop_back();
+        index.pop_back();
+      }
+
+      // descend to a leaf, keys equal to a separator go right
+      node<T>* x = path.back();
+      while (!x->children.empty()) {
+        const int i = std::upper_bound(x->keys.begin(), x->keys.end(), key) -
+                      x->keys.begin();
+        index.push_back(i);
+        bounds.push_back(i < (int)x->keys.size() ? &x->keys[i] : bounds.back());
+        path.push_back(x = x->own(i));
+      }
+      x->keys.insert(std::upper_bound(x->keys.begin(), x->keys.end(), key),
+                     key);
+      if ((int)x->keys.size() < 2 * t) continue;
+
+      // split overflowing nodes back up the path, following key
+      for (int d = path.size() - 1; d >= 0; d--) {
+        if ((int)path[d]->keys.size() < 2 * t) break;
+
+        // if root overflows, create new root above it
+        if (!d) {
+          root = new node<T>(t);
+          root->size = path[0]->size;
+          root->children.push_back(path[0]);
+          path.insert(path.begin(), root);
+          index.insert(index.begin(), 0);
+          d++;
+        }
+
+        node<T>* parent = path[d - 1];
+        const int j = index[d - 1];
+        parent->split_overflowing_child(j);
+        if (!(key < parent->keys[j])) {
+          path[d] = parent->children[j + 1];
+          index[d - 1]++;
+          if (d < (int)index.size()) index[d] -= t + 1;
+        }
+      }
+
+      // separators moved, so bounds are looked up again
+      bounds.assign(1, nullptr);
+      for (int d = 1; d < (int)path.size(); d++) {
+        const node<T>* parent = path[d - 1];
+        const int j = index[d - 1];
+        bounds.push_back(j < (int)parent->keys.size() ? &parent->keys[j]
+                                                      : bounds.back());
+      }
+    }
+
+    for (int d = path.size() - 1; d >= 0; d--) path[d]->update_size();
+  }
+
+  template <typename Iterator>
+  void bulk_load(Iterator begin, Iterator end, const double fill = 1.0) {
+    // replace contents by sorted range [begin, end), building the tree
+    // bottom-up with nodes holding about fill * (2t - 1) keys
+    const int capacity = std::max(
+        t - 1, std::min(2 * t - 1, (int)(fill * (2 * t - 1) + 0.5)));
+
+    // fill leaves, promoting the key after each full leaf as separator
+    std::vector<node<T>*> level(1, new node<T>(t));
+    std::vector<T> separators;
+    for (Iterator it = begin; it != end; ++it) {
+      if ((int)level.back()->keys.size() == capacity) {
+        separators.push_back(*it);
+        level.push_back(new node<T>(t));
+      } else
+        level.back()->keys.push_back(*it);
+    }
+    if (level.size() > 1) rebalance_last(level, separators);
+
+    // group each capacity + 1 nodes under a parent until one node is left
+    while (level.size() > 1) {
+      std::vector<node<T>*> parents(1, new node<T>(t));
+      std::vector<T> parent_separators;
+      const int n = level.size();
+      parents.back()->children.push_back(level[0]);
+      for (int i = 1; i < n; i++) {
+        if ((int)parents.back()->children.size() == capacity + 1) {
+          parent_separators.push_back(separators[i - 1]);
+          parents.push_back(new node<T>(t));
+        } else
+          parents.back()->keys.push_back(separators[i - 1]);
+        parents.back()->children.push_back(level[i]);
+      }
+      if (parents.size() > 1) rebalance_last(parents, parent_separators);
+
+      level.swap(parents);
+      separators.swap(parent_separators);
+    }
+
+    node<T>::release(root);
+    root = level[0];
+    root->recount();
+  }
+
+  template <typename Iterator>
+  void merge(Iterator begin, Iterator end, const double fill = 1.0) {
+    // insert sorted range [begin, end)
+    // small batches go down shared paths by insert_sorted, large ones
+    // rebuild the tree, the only case needing its keys listed
+    std::vector<T> batch(begin, end);
+    const double depth = std::log(root->size + 2) / std::log(t + 1);
+    if (batch.size() * depth < root->size) {
+      insert_sorted(batch.begin(), batch.end());
+      return;
+    }
+
+    std::vector<T> current;
+    root->collect(current);
+    std::vector<T> merged;
+    merged.reserve(current.size() + batch.size());
+    std::merge(current.begin(), current.end(), batch.begin(), batch.end(),
+               std::back_inserter(merged));
+    bulk_load(merged.begin(), merged.end(), fill);
+  }
+
+  int size() const { return root->size; }
+
+  int rank(const T& key) const { return root->rank(key); }
+
+  const T& select(const int k) const { return root->select(k); }
+
   void print(std::ostream& stream) const { root->print(stream, 0); }
 
+  const node<T>* get_root() const { return root; }
+
+  void save(std::ostream& stream) const {
+    /* writes a binary image of the tree, laid out as told by image_header. */
+
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "keys must be trivially copyable to be saved");
+
+    // list nodes in level order, so children of a node are consecutive
+    std::vector<const node<T>*> order(1, root);
+    for (std::size_t i = 0; i < order.size(); i++)
+      for (const node<T>* child : order[i]->children) order.push_back(child);
+
+    image_header header = image_header();
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof header.magic);
+    header.version = IMAGE_VERSION;
+    header.key_size = sizeof(T);
+    header.t = t;
+    header.n_nodes = order.size();
+    header.n_keys = root->size;
+    header.byte_order = IMAGE_BYTE_ORDER;
+    stream.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+    std::uint64_t keys = 0, children = 1;
+    for (const node<T>* x : order) {
+      image_node entry = image_node();
+      entry.keys = keys;
+      entry.children = (x->children.empty() ? 0 : children);
+      entry.size = x->size;
+      entry.n = x->keys.size();
+      stream.write(reinterpret_cast<const char*>(&entry), sizeof entry);
+      keys += x->keys.size();
+      children += x->children.size();
+    }
+    for (const node<T>* x : order)
+      stream.write(reinterpret_cast<const char*>(x->keys.data()),
+                   x->keys.size() * sizeof(T));
+
+    if (!stream) throw std::runtime_error("Unable to write image");
+  }
+
+  void load(std::istream& stream) {
+    /* replaces contents by those of an image written by save, rebuilding
+    its nodes in linear time. the image must have the same minimum degree. */
+
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "keys must be trivially copyable to be loaded");
+
+    image_header header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof header);
+    if (!stream) throw std::runtime_error("Unable to read image");
+    check_image_header(header, sizeof(T));
+    if ((int)header.t != t)
+      throw std::runtime_error(
+          "Unexpected minimum degree. Expected degree " + std::to_string(t) +
+          " and got " + std::to_string(header.t));
+
+    // every node but the root is listed as a child before its own entry
+    std::vector<image_node> entries;
+    std::uint64_t keys = 0, children = 1;
+    for (std::uint64_t i = 0; i < header.n_nodes; i++) {
+      image_node entry;
+      stream.read(reinterpret_cast<char*>(&entry), sizeof entry);
+      if (!stream) throw std::runtime_error("Unable to read image");
+      if (entry.keys != keys || (int)entry.n > 2 * t - 1 ||
+          (i && i >= children) || (entry.children && entry.children != children))
+        throw std::runtime_error("Corrupt image");
+      keys += entry.n;
+      if (entry.children) children += entry.n + 1;
+      entries.push_back(entry);
+    }
+    if (entries.empty() || keys != header.n_keys || children != header.n_nodes)
+      throw std::runtime_error("Corrupt image");
+
+    std::vector<node<T>*> nodes;
+    nodes.reserve(entries.size());
+    try {
+      for (const image_node& entry : entries) {
+        nodes.push_back(new node<T>(t));
+        std::vector<T>& node_keys = nodes.back()->keys;
+        node_keys.resize(entry.n);
+        stream.read(reinterpret_cast<char*>(node_keys.data()),
+                    entry.n * sizeof(T));
+        if (!stream) throw std::runtime_error("Unable to read image");
+      }
+    } catch (...) {
+      for (node<T>* x : nodes) delete x;
+      throw;
+    }
+
+    for (std::size_t i = 0; i < nodes.size(); i++)
+      if (entries[i].children)
+        nodes[i]->children.assign(
+            nodes.begin() + entries[i].children,
+            nodes.begin() + entries[i].children + entries[i].n + 1);
+
+    node<T>::release(root);
+    root = nodes[0];
+    root->recount();
+  }
+
+  b::snapshot<T> snapshot() const {
+    /* returns: view of the current contents, taken in constant time */
+
+    return b::snapshot<T>(root);
+  }
+
  private:
   const int t;
   node<T>* root;
+
+  static void shrink(node<T>*& x) {
+    // if root is emptied by deletion, make left child new root
+    if (x->keys.empty() && !x->children.empty()) {
+      node<T>* new_root = x->children[0];
+      x->children.clear();
+      delete x;
+      x = new_root;
+    }
+  }
+
+  static int height(const node<T>* x) {
+    int ret = 0;
+    for (; !x->children.empty(); x = x->children[0]) ret++;
+    return ret;
+  }
+
+  void split(node<T>* x, const T& key, node<T>*& left, node<T>*& right) {
+    /* splits tree rooted at 'x' into tree 'left', with the keys smaller than
+    'key', and tree 'right', with the rest. */
+
+    x = node<T>::owned(x);
+    const int n = x->keys.size();
+    const int i =
+        std::lower_bound(x->keys.begin(), x->keys.end(), key) - x->keys.begin();
+
+    if (x->children.empty()) {
+      right = new node<T>(t);
+      right->keys.assign(x->keys.begin() + i, x->keys.end());
+      right->update_size();
+      x->keys.erase(x->keys.begin() + i, x->keys.end());
+      x->update_size();
+      left = x;
+      return;
+    }
+
+    // split child i, then join each of its halves with the keys and
+    // subtrees on the same side
+    node<T>* child_left;
+    node<T>* child_right;
+    split(x->children[i], key, child_left, child_right);
+
+    right = child_right;
+    if (i < n) {
+      node<T>* rest = x->children[n];
+      if (i + 1 < n) {
+        rest = new node<T>(t);
+        rest->keys.assign(x->keys.begin() + i + 1, x->keys.end());
+        rest->children.assign(x->children.begin() + i + 1, x->children.end());
+        rest->update_size();
+      }
+      right = join(child_right, x->keys[i], rest);
+    }
+
+    left = child_left;
+    node<T>* rest = nullptr;
+    if (i > 1) {
+      // x keeps the first i - 1 keys
+      const T separator = x->keys[i - 1];
+      x->keys.erase(x->keys.begin() + i - 1, x->keys.end());
+      x->children.erase(x->children.begin() + i, x->children.end());
+      x->update_size();
+      left = join(x, separator, child_left);
+      return;
+    } else if (i == 1)
+      rest = x->children[0];
+
+    // delete x without the children handed out
+    if (rest) left = join(rest, x->keys[0], child_left);
+    x->children.clear();
+    delete x;
+  }
+
+  node<T>* join(node<T>* left, const T& key, node<T>* right) {
+    /* joins trees 'left' and 'right' around 'key', which is no smaller than
+    the keys of left and no greater than those of right.
+    - returns: root of the joined tree */
+
+    const int left_height = height(left), right_height = height(right);
+    if (left_height == right_height) {
+      left = node<T>::owned(left);
+      right = node<T>::owned(right);
+      if ((int)(left->keys.size() + right->keys.size()) < 2 * t - 1) {
+        // everything fits the left root
+        left->keys.push_back(key);
+        std::copy(right->keys.begin(), right->keys.end(),
+                  std::back_inserter(left->keys));
+        std::copy(right->children.begin(), right->children.end(),
+                  std::back_inserter(left->children));
+        left->size += right->size + 1;
+        right->children.clear();
+        delete right;
+        return left;
+      }
+
+      node<T>* x = new node<T>(t);
+      x->keys.push_back(key);
+      x->children.push_back(left);
+      x->children.push_back(right);
+      x->update_size();
+      balance(x, 0);
+      return x;
+    }
+
+    // hang the lower tree from the spine of the higher one, on its side
+    const bool taller_left = (left_height > right_height);
+    node<T>* top = node<T>::owned(taller_left ? left : right);
+    node<T>* lower = (taller_left ? right : left);
+    std::vector<node<T>*> spine(1, top);
+    for (int h = std::abs(left_height - right_height); h > 1; h--) {
+      node<T>* x = spine.back();
+      spine.push_back(x->own(taller_left ? x->children.size() - 1 : 0));
+    }
+    for (node<T>* x : spine) x->size += lower->size + 1;
+
+    node<T>* x = spine.back();
+    if (taller_left) {
+      x->keys.push_back(key);
+      x->children.push_back(lower);
+      balance(x, x->keys.size() - 1);
+    } else {
+      x->keys.insert(x->keys.begin(), key);
+      x->children.insert(x->children.begin(), lower);
+      balance(x, 0);
+    }
+
+    // split overflowing nodes back up the spine
+    for (int d = spine.size() - 1; d > 0; d--) {
+      if ((int)spine[d]->keys.size() < 2 * t) break;
+      spine[d - 1]->split_overflowing_child(
+          taller_left ? spine[d - 1]->children.size() - 1 : 0);
+    }
+    if ((int)top->keys.size() == 2 * t) {
+      // if root overflows, create new root above it
+      node<T>* x = new node<T>(t);
+      x->size = top->size;
+      x->children.push_back(top);
+      x->split_overflowing_child(0);
+      top = x;
+    }
+    return top;
+  }
+
+  void balance(node<T>* x, const int i) {
+    /* leaves children 'i' and 'i + 1' of 'x' with at least t - 1 keys each,
+    merging them or sharing their keys evenly. */
+
+    node<T>* left = x->children[i];
+    node<T>* right = x->children[i + 1];
+    const int n = left->keys.size() + right->keys.size();
+    if ((int)left->keys.size() >= t - 1 && (int)right->keys.size() >= t - 1)
+      return;
+    if (n < 2 * t - 1) {
+      x->merge_right_left(i);
+      return;
+    }
+
+    left = x->own(i);
+    right = x->own(i + 1);
+    std::vector<T> keys(left->keys);
+    keys.push_back(x->keys[i]);
+    std::copy(right->keys.begin(), right->keys.end(), std::back_inserter(keys));
+    std::vector<node<T>*> children(left->children);
+    std::copy(right->children.begin(), right->children.end(),
+              std::back_inserter(children));
+
+    const int m = keys.size() / 2;
+    left->keys.assign(keys.begin(), keys.begin() + m);
+    x->keys[i] = keys[m];
+    right->keys.assign(keys.begin() + m + 1, keys.end());
+    if (!children.empty()) {
+      left->children.assign(children.begin(), children.begin() + m + 1);
+      right->children.assign(children.begin() + m + 1, children.end());
+    }
+    left->update_size();
+    right->update_size();
+  }
+
+  void rebalance_last(std::vector<node<T>*>& level, std::vector<T>& separators) {
+    // the last node of a bulk loaded level may be underfull
+    // redistribute it with its left sibling and their separator
+    node<T>* right = level.back();
+    if ((int)right->keys.size() >= t - 1) return;
+    node<T>* left = level[level.size() - 2];
+
+    left->keys.push_back(separators.back());
+    separators.pop_back();
+    std::copy(right->keys.begin(), right->keys.end(),
+              std::back_inserter(left->keys));
+    std::copy(right->children.begin(), right->children.end(),
+              std::back_inserter(left->children));
+    right->keys.clear();
+    right->children.clear();
+
+    const int n = left->keys.size();
+    if (n <= 2 * t - 1) {
+      // everything fits the left node
+      delete right;
+      level.pop_back();
+    } else {
+      // split evenly around the median, as split_child does
+      const int m = n / 2;
+      std::copy(left->keys.begin() + m + 1, left->keys.end(),
+                std::back_inserter(right->keys));
+      if (!left->children.empty()) {
+        std::copy(left->children.begin() + m + 1, left->children.end(),
+                  std::back_inserter(right->children));
+        left->children.erase(left->children.begin() + m + 1,
+                             left->children.end());
+      }
+      separators.push_back(left->keys[m]);
+      left->keys.erase(left->keys.begin() + m, left->keys.end());
+    }
+  }
 };
 }
 
@@ -0,0 +1,149 @@
+#ifndef BTREE_IMAGE_HPP
+#define BTREE_IMAGE_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "btree.hpp"
+
+namespace b {
+
+// read-only b::tree searched in place in a memory mapped image written by
+// tree::save, so it is ready as soon as the file is opened
+// pages of the image are only read in as searches reach them
+template <typename T>
+class image {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "keys must be trivially copyable to be mapped");
+  static_assert(alignof(T) <= alignof(image_node),
+                "keys must not need more alignment than image entries");
+
+ public:
+  explicit image(const std::string& file_name) {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Unable to open file " + file_name);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(image_header)) {
+      close(fd);
+      throw std::runtime_error("Not a b::tree image: " + file_name);
+    }
+    length = st.st_size;
+
+    // the mapping outlives the descriptor
+    data = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+      throw std::runtime_error("Unable to map file " + file_name);
+
+    header = static_cast<const image_header*>(data);
+    try {
+      check_image_header(*header, sizeof(T));
+      const std::size_t max_nodes =
+          (length - sizeof(image_header)) / sizeof(image_node);
+      if (!header->n_nodes || header->n_nodes > max_nodes ||
+          header->n_keys != (length - sizeof(image_header) -
+                             header->n_nodes * sizeof(image_node)) /
+                                sizeof(T))
+        throw std::runtime_error("Corrupt image");
+    } catch (...) {
+      munmap(data, length);
+      throw;
+    }
+
+    nodes = reinterpret_cast<const image_node*>(header + 1);
+    keys = reinterpret_cast<const T*>(nodes + header->n_nodes);
+  }
+
+  ~image() { munmap(data, length); }
+
+  image(const image&) = delete;
+  image& operator=(const image&) = delete;
+
+  bool search(const T& key) const {
+    std::uint64_t x = 0;
+    for (;;) {
+      const T* first = keys_of(x);
+      const T* last = first + nodes[x].n;
+      const T* it = std::lower_bound(first, last, key);
+      if (it != last && *it == key) return true;
+      if (!nodes[x].children) return false;
+      x = child(x, it - first);
+    }
+  }
+
+  int size() const { return header->n_keys; }
+
+  int rank(const T& key) const {
+    /* returns: number of keys smaller than 'key' */
+
+    int ret = 0;
+    std::uint64_t x = 0;
+    for (;;) {
+      const T* first = keys_of(x);
+      const int i = std::lower_bound(first, first + nodes[x].n, key) - first;
+      ret += i;
+      if (!nodes[x].children) return ret;
+
+      // keys left of i and their subtrees are smaller
+      for (int j = 0; j < i; j++) ret += nodes[child(x, j)].size;
+      x = child(x, i);
+    }
+  }
+
+  const T& select(int k) const {
+    /* returns: kth smallest key, counting from 0 */
+
+    if (k < 0 || k >= size())
+      throw std::out_of_range("No key of rank " + std::to_string(k));
+
+    std::uint64_t x = 0;
+    for (;;) {
+      const T* first = keys_of(x);
+      if (!nodes[x].children) return first[k];
+
+      // skip whole subtrees and the keys after them until k falls in one
+      int i = 0;
+      while (k > (int)nodes[child(x, i)].size) {
+        k -= nodes[child(x, i)].size + 1;
+        i++;
+      }
+      if (k == (int)nodes[child(x, i)].size) return first[i];
+      x = child(x, i);
+    }
+  }
+
+ private:
+  void* data;
+  std::size_t length;
+  const image_header* header;
+  const image_node* nodes;
+  const T* keys;
+
+  const T* keys_of(const std::uint64_t x) const {
+    // entries are checked as they are reached rather than all up front
+    if (nodes[x].keys > header->n_keys ||
+        nodes[x].n > header->n_keys - nodes[x].keys)
+      throw std::runtime_error("Corrupt image");
+    return keys + nodes[x].keys;
+  }
+
+  std::uint64_t child(const std::uint64_t x, const int i) const {
+    // children follow their parent, so no search runs in circles
+    const std::uint64_t ret = nodes[x].children + i;
+    if (ret <= x || ret >= header->n_nodes || i > (int)nodes[x].n)
+      throw std::runtime_error("Corrupt image");
+    return ret;
+  }
+};
+}
+
+#endif
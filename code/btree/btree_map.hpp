@@ -0,0 +1,402 @@
+#ifndef BTREE_MAP_HPP
+#define BTREE_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "fixed_btree.hpp"
+
+namespace b {
+
+// objects carved out of chunks that grow geometrically up to MAX_CHUNK
+// released objects are reused and only freed along with the pool
+template <typename N>
+class pool {
+ public:
+  static const std::size_t MAX_CHUNK = 1024;
+
+  pool() : chunk_size(16) {}
+
+  N* allocate() {
+    if (free_objects.empty()) {
+      chunks.emplace_back(new N[chunk_size]);
+      for (std::size_t i = chunk_size; i-- > 0;)
+        free_objects.push_back(&chunks.back()[i]);
+      if (chunk_size < MAX_CHUNK) chunk_size *= 2;
+    }
+
+    N* x = free_objects.back();
+    free_objects.pop_back();
+    return x;
+  }
+
+  void release(N* x) { free_objects.push_back(x); }
+
+  void clear() {
+    chunks.clear();
+    free_objects.clear();
+    chunk_size = 16;
+  }
+
+ private:
+  std::size_t chunk_size;
+  std::vector<std::unique_ptr<N[]>> chunks;
+  std::vector<N*> free_objects;
+};
+
+template <typename K, typename V, int t>
+struct map_node {
+  int n;
+  bool leaf;
+
+  // one spare slot holds the overflowing entry until the node is split
+  K keys[2 * t];
+  V values[2 * t];
+  map_node* children[2 * t + 1];
+};
+
+// b::tree mapping unique keys to values, with nodes drawn from a pool
+// insert and erase walk down once, remembering the path, and split or fix
+// nodes on the way back up, moving entries instead of copying them
+// K and V must be default constructible
+template <typename K, typename V, int t = 16>
+class map {
+  static_assert(t >= 2, "minimum degree must be at least 2");
+
+  typedef map_node<K, V, t> node;
+
+ public:
+  map() : len(0) { root = new_node(true); }
+
+  map(map&& other) : map() { *this = std::move(other); }
+
+  map& operator=(map&& other) {
+    std::swap(nodes, other.nodes);
+    std::swap(root, other.root);
+    std::swap(len, other.len);
+    return *this;
+  }
+
+  map(const map&) = delete;
+  map& operator=(const map&) = delete;
+
+  std::size_t size() const { return len; }
+
+  V* find(const K& key) {
+    node* x;
+    int i;
+    return (locate(key, x, i) ? &x->values[i] : nullptr);
+  }
+
+  const V* find(const K& key) const {
+    node* x;
+    int i;
+    return (locate(key, x, i) ? &x->values[i] : nullptr);
+  }
+
+  bool insert(K key, V value) {
+    /* maps 'key' to 'value' unless key is already present.
+    - returns: whether it was inserted */
+
+    return emplace(key, value).second;
+  }
+
+  V& operator[](const K& key) {
+    V* value = find(key);
+    if (value) return *value;
+
+    K new_key(key);
+    V new_value = V();
+    return *emplace(new_key, new_value).first;
+  }
+
+  bool erase(const K& key) {
+    /* returns: whether key was found */
+
+    std::pair<node*, int> path[MAX_HEIGHT];
+    int depth = 0;
+    node* x = root;
+    int i;
+    for (;;) {
+      i = position(x->keys, x->n, key, false);
+      if (i < x->n && x->keys[i] == key) break;
+      if (x->leaf) return false;
+      path[depth++] = std::make_pair(x, i);
+      x = x->children[i];
+    }
+
+    if (!x->leaf) {
+      // replace key by its predecessor, moved out of the rightmost leaf of
+      // the left subtree
+      path[depth++] = std::make_pair(x, i);
+      node* y = x->children[i];
+      while (!y->leaf) {
+        path[depth++] = std::make_pair(y, y->n);
+        y = y->children[y->n];
+      }
+      x->keys[i] = std::move(y->keys[y->n - 1]);
+      x->values[i] = std::move(y->values[y->n - 1]);
+      x = y;
+      i = y->n - 1;
+    }
+
+    // erase from leaf, clearing the slot left behind
+    std::move(x->keys + i + 1, x->keys + x->n, x->keys + i);
+    std::move(x->values + i + 1, x->values + x->n, x->values + i);
+    x->n--;
+    x->keys[x->n] = K();
+    x->values[x->n] = V();
+    len--;
+
+    // restore at least t - 1 keys on every node back up the path
+    while (depth > 0 && x->n < t - 1) {
+      node* parent = path[--depth].first;
+      const int j = path[depth].second;
+      node* left = (j > 0 ? parent->children[j - 1] : nullptr);
+      node* right = (j < parent->n ? parent->children[j + 1] : nullptr);
+
+      if (left && left->n >= t) {
+        rotate_right(parent, j);
+        break;
+      }
+      if (right && right->n >= t) {
+        rotate_left(parent, j);
+        break;
+      }
+
+      // merge with a sibling, descending a key from the parent
+      merge_right_left(parent, right ? j : j - 1);
+      x = parent;
+    }
+
+    // if root is emptied by deletion, make left child new root
+    if (!root->n && !root->leaf) {
+      node* r = root;
+      root = r->children[0];
+      nodes.release(r);
+    }
+
+    return true;
+  }
+
+  void clear() {
+    nodes.clear();
+    root = new_node(true);
+    len = 0;
+  }
+
+  void collect(std::vector<std::pair<K, V>>& ret) const { collect(root, ret); }
+
+  void print(std::ostream& stream) const { print(stream, root, 0); }
+
+  const node* get_root() const { return root; }
+
+ private:
+  // nodes have at least two children, so no path is longer than the bits
+  // of a size
+  static const int MAX_HEIGHT = 64;
+
+  pool<node> nodes;
+  node* root;
+  std::size_t len;
+
+  node* new_node(const bool leaf) {
+    node* x = nodes.allocate();
+    x->n = 0;
+    x->leaf = leaf;
+    return x;
+  }
+
+  bool locate(const K& key, node*& x, int& i) const {
+    x = root;
+    for (;;) {
+      i = position(x->keys, x->n, key, false);
+      if (i < x->n && x->keys[i] == key) return true;
+      if (x->leaf) return false;
+      x = x->children[i];
+    }
+  }
+
+  std::pair<V*, bool> emplace(K& key, V& value) {
+    /* moves 'key' and 'value' into the tree unless key is already present.
+    - returns: the value mapped to key and whether it was inserted */
+
+    std::pair<node*, int> path[MAX_HEIGHT];
+    int depth = 0;
+    node* x = root;
+    int i;
+    for (;;) {
+      i = position(x->keys, x->n, key, false);
+      if (i < x->n && x->keys[i] == key)
+        return std::make_pair(&x->values[i], false);
+      if (x->leaf) break;
+      path[depth++] = std::make_pair(x, i);
+      x = x->children[i];
+    }
+
+    shift_in(x, i, key, value, nullptr);
+    len++;
+
+    // split overflowing nodes back up the path, following the new entry
+    node* at = x;
+    int at_i = i;
+    while (x->n == 2 * t) {
+      node* right = split(x);
+      if (at == x && at_i > t) {
+        at = right;
+        at_i -= t + 1;
+      }
+
+      // if root is split, create new root above it
+      node* parent;
+      int j;
+      if (depth > 0) {
+        parent = path[--depth].first;
+        j = path[depth].second;
+      } else {
+        parent = root = new_node(false);
+        parent->children[0] = x;
+        j = 0;
+      }
+
+      // move median up
+      shift_in(parent, j, x->keys[t], x->values[t], right);
+      if (at == x && at_i == t) {
+        at = parent;
+        at_i = j;
+      }
+      x = parent;
+    }
+
+    return std::make_pair(&at->values[at_i], true);
+  }
+
+  void shift_in(node* x, const int i, K& key, V& value, node* right) {
+    /* moves 'key' and 'value' into slot 'i' of node 'x', with 'right' as
+    the child after them unless x is a leaf. */
+
+    std::move_backward(x->keys + i, x->keys + x->n, x->keys + x->n + 1);
+    std::move_backward(x->values + i, x->values + x->n, x->values + x->n + 1);
+    x->keys[i] = std::move(key);
+    x->values[i] = std::move(value);
+    if (!x->leaf) {
+      std::copy_backward(x->children + i + 1, x->children + x->n + 1,
+                         x->children + x->n + 2);
+      x->children[i + 1] = right;
+    }
+    x->n++;
+  }
+
+  node* split(node* x) {
+    /* splits overflowing node 'x', keeping its first t keys and leaving its
+    median in slot t.
+    - returns: new right sibling holding the upper t - 1 keys */
+
+    node* right = new_node(x->leaf);
+    right->n = t - 1;
+    std::move(x->keys + t + 1, x->keys + 2 * t, right->keys);
+    std::move(x->values + t + 1, x->values + 2 * t, right->values);
+    if (!x->leaf)
+      std::copy(x->children + t + 1, x->children + 2 * t + 1, right->children);
+    x->n = t;
+    return right;
+  }
+
+  void rotate_left(node* x, const int i) {
+    // descend a key from current node to child i and replace it
+    // with leftmost key of its right sibling
+    node* child = x->children[i];
+    node* right = x->children[i + 1];
+    child->keys[child->n] = std::move(x->keys[i]);
+    child->values[child->n] = std::move(x->values[i]);
+    x->keys[i] = std::move(right->keys[0]);
+    x->values[i] = std::move(right->values[0]);
+    std::move(right->keys + 1, right->keys + right->n, right->keys);
+    std::move(right->values + 1, right->values + right->n, right->values);
+
+    if (!child->leaf) {
+      // move right sibling's leftmost child to child i
+      child->children[child->n + 1] = right->children[0];
+      std::copy(right->children + 1, right->children + right->n + 1,
+                right->children);
+    }
+    child->n++;
+    right->n--;
+  }
+
+  void rotate_right(node* x, const int i) {
+    // descend a key from current node to child i and replace it
+    // with rightmost key of its left sibling
+    node* child = x->children[i];
+    node* left = x->children[i - 1];
+    std::move_backward(child->keys, child->keys + child->n,
+                       child->keys + child->n + 1);
+    std::move_backward(child->values, child->values + child->n,
+                       child->values + child->n + 1);
+    child->keys[0] = std::move(x->keys[i - 1]);
+    child->values[0] = std::move(x->values[i - 1]);
+    x->keys[i - 1] = std::move(left->keys[left->n - 1]);
+    x->values[i - 1] = std::move(left->values[left->n - 1]);
+
+    if (!child->leaf) {
+      // move left sibling's rightmost child to child i
+      std::copy_backward(child->children, child->children + child->n + 1,
+                         child->children + child->n + 2);
+      child->children[0] = left->children[left->n];
+    }
+    child->n++;
+    left->n--;
+  }
+
+  void merge_right_left(node* x, const int i) {
+    node* left = x->children[i];
+    node* right = x->children[i + 1];
+
+    // descend ith-key to be new median
+    left->keys[left->n] = std::move(x->keys[i]);
+    left->values[left->n] = std::move(x->values[i]);
+    std::move(x->keys + i + 1, x->keys + x->n, x->keys + i);
+    std::move(x->values + i + 1, x->values + x->n, x->values + i);
+    std::copy(x->children + i + 2, x->children + x->n + 1, x->children + i + 1);
+    x->n--;
+
+    // append the keys and children of the right child to left's
+    std::move(right->keys, right->keys + right->n, left->keys + left->n + 1);
+    std::move(right->values, right->values + right->n,
+              left->values + left->n + 1);
+    if (!left->leaf)
+      std::copy(right->children, right->children + right->n + 1,
+                left->children + left->n + 1);
+    left->n += right->n + 1;
+
+    nodes.release(right);
+  }
+
+  void collect(const node* x, std::vector<std::pair<K, V>>& ret) const {
+    // append entries in key order
+    for (int i = 0; i < x->n; i++) {
+      if (!x->leaf) collect(x->children[i], ret);
+      ret.emplace_back(x->keys[i], x->values[i]);
+    }
+    if (!x->leaf) collect(x->children[x->n], ret);
+  }
+
+  void print(std::ostream& stream, const node* x, const int level) const {
+    for (int i = 0; i < level; i++) stream << " ";
+    stream << "[";
+    for (int i = 0; i < x->n; i++) {
+      stream << x->keys[i];
+      if (i < x->n - 1) stream << " ";
+    }
+    stream << "]" << std::endl;
+    if (!x->leaf)
+      for (int i = 0; i <= x->n; i++) print(stream, x->children[i], level + 1);
+  }
+};
+}
+
+#endif
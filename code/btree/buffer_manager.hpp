@@ -0,0 +1,226 @@
+#ifndef BUFFER_MANAGER_HPP
+#define BUFFER_MANAGER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace b {
+
+// file of fixed-size pages cached in a fixed number of frames
+// pages are pinned while in use and unpinned ones are evicted in LRU order
+// page 0 holds the file header, so no page handed out is ever 0
+class buffer_manager {
+ public:
+  static const std::uint32_t NIL = 0;
+
+  buffer_manager(const std::string& file_name, const std::size_t page_size,
+                 const std::size_t n_frames)
+      : page_size(page_size), frames(n_frames), reads(0), writes(0) {
+    if (page_size < sizeof(file_header))
+      throw std::runtime_error("Page size too small");
+    for (frame& f : frames) f.data.resize(page_size);
+
+    handle.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
+    if (handle.is_open()) {
+      // read header of existing file, which may be short or not ours
+      handle.read(reinterpret_cast<char*>(&header), sizeof header);
+      if (handle.gcount() != sizeof header || !handle)
+        throw std::runtime_error("Unable to read header of " + file_name);
+      if (header.magic != MAGIC)
+        throw std::runtime_error(file_name + " is not a page file");
+      if (header.version != VERSION)
+        throw std::runtime_error(
+            "Unexpected page file version. Expected version " +
+            std::to_string(VERSION) + " and got " +
+            std::to_string(header.version));
+      if (header.page_size != page_size)
+        throw std::runtime_error(
+            "Unexpected page size. Expected size " + std::to_string(page_size) +
+            " and got " + std::to_string(header.page_size));
+      if (!header.n_pages || header.free_head >= header.n_pages ||
+          header.root >= header.n_pages)
+        throw std::runtime_error("Corrupt header of " + file_name);
+    } else {
+      handle.open(file_name, std::ios::in | std::ios::out | std::ios::binary |
+                                 std::ios::trunc);
+      if (!handle.is_open())
+        throw std::runtime_error("Unable to create file " + file_name);
+
+      header.magic = MAGIC;
+      header.version = VERSION;
+      header.page_size = page_size;
+      header.n_pages = 1;
+      header.free_head = NIL;
+      header.root = NIL;
+      write_header();
+    }
+  }
+
+  // errors writing back are lost here, so flush first to catch them
+  ~buffer_manager() {
+    try {
+      flush();
+    } catch (const std::runtime_error&) {
+    }
+  }
+
+  buffer_manager(const buffer_manager&) = delete;
+  buffer_manager& operator=(const buffer_manager&) = delete;
+
+  char* pin(const std::uint32_t id) {
+    /* pins page 'id', reading it from the file if it is not cached.
+    - returns: pointer to the page contents, valid until unpinned */
+
+    std::unordered_map<std::uint32_t, std::size_t>::iterator it =
+        table.find(id);
+    if (it != table.end()) {
+      frame& f = frames[it->second];
+      if (!f.pins++) lru.erase(f.lru_pos);
+      return f.data.data();
+    }
+
+    frame& f = frames[claim(id)];
+    handle.seekg((std::streamoff)id * page_size);
+    handle.read(f.data.data(), page_size);
+    if (!handle) throw std::runtime_error("Unable to read page");
+    reads++;
+
+    return f.data.data();
+  }
+
+  void unpin(const std::uint32_t id, const bool dirty) {
+    /* releases one pin of page 'id', which becomes evictable once it has no
+    pins left.
+    - 'dirty': whether the page was modified while pinned */
+
+    frame& f = frames[table.at(id)];
+    f.dirty = f.dirty || dirty;
+    if (!--f.pins) f.lru_pos = lru.insert(lru.end(), table.at(id));
+  }
+
+  std::uint32_t allocate() {
+    /* allocates a zeroed page, reusing released pages first.
+    - returns: id of the new page, pinned once */
+
+    std::uint32_t id;
+    char* data;
+    if (header.free_head != NIL) {
+      // pop page from free list, linked through its first bytes
+      id = header.free_head;
+      data = pin(id);
+      std::memcpy(&header.free_head, data, sizeof header.free_head);
+    } else {
+      // extend file, written on eviction or flush
+      id = header.n_pages++;
+      data = frames[claim(id)].data.data();
+    }
+
+    std::memset(data, 0, page_size);
+    frames[table.at(id)].dirty = true;
+    return id;
+  }
+
+  void release(const std::uint32_t id) {
+    /* pushes unpinned page 'id' to the free list. */
+
+    char* data = pin(id);
+    std::memcpy(data, &header.free_head, sizeof header.free_head);
+    header.free_head = id;
+    unpin(id, true);
+  }
+
+  void flush() {
+    /* writes every dirty page and the header to the file. throws
+    std::runtime_error if writing fails. */
+
+    for (frame& f : frames)
+      if (f.id != NIL && f.dirty) write_back(f);
+    write_header();
+    if (!handle.flush()) throw std::runtime_error("Unable to flush pages");
+  }
+
+  std::uint32_t get_root() const { return header.root; }
+  void set_root(const std::uint32_t root) { header.root = root; }
+
+  std::size_t get_page_size() const { return page_size; }
+  std::uint32_t get_n_pages() const { return header.n_pages; }
+  unsigned long long get_reads() const { return reads; }
+  unsigned long long get_writes() const { return writes; }
+
+ private:
+  // "BTPG" read as a little-endian word
+  static const std::uint32_t MAGIC = 0x47505442;
+  static const std::uint32_t VERSION = 1;
+
+  struct file_header {
+    std::uint32_t magic, version;
+    std::uint32_t page_size, n_pages, free_head, root;
+  };
+
+  struct frame {
+    frame() : id(NIL), pins(0), dirty(false) {}
+    std::uint32_t id;
+    int pins;
+    bool dirty;
+    std::vector<char> data;
+    std::list<std::size_t>::iterator lru_pos;
+  };
+
+  const std::size_t page_size;
+  std::fstream handle;
+  file_header header;
+
+  std::vector<frame> frames;
+  std::unordered_map<std::uint32_t, std::size_t> table;
+
+  // unpinned frames, least recently used first
+  std::list<std::size_t> lru;
+
+  unsigned long long reads, writes;
+
+  std::size_t claim(const std::uint32_t id) {
+    /* assigns a frame to page 'id', evicting the least recently used
+    unpinned page if every frame is taken.
+    - returns: index of the frame, pinned once */
+
+    std::size_t i;
+    if (table.size() < frames.size())
+      i = table.size();
+    else {
+      if (lru.empty()) throw std::runtime_error("Every frame is pinned");
+      i = lru.front();
+      lru.pop_front();
+      if (frames[i].dirty) write_back(frames[i]);
+      table.erase(frames[i].id);
+    }
+
+    frames[i].id = id;
+    frames[i].pins = 1;
+    frames[i].dirty = false;
+    table[id] = i;
+    return i;
+  }
+
+  void write_back(frame& f) {
+    handle.seekp((std::streamoff)f.id * page_size);
+    handle.write(f.data.data(), page_size);
+    if (!handle) throw std::runtime_error("Unable to write page");
+    f.dirty = false;
+    writes++;
+  }
+
+  void write_header() {
+    handle.seekp(0);
+    handle.write(reinterpret_cast<const char*>(&header), sizeof header);
+    if (!handle) throw std::runtime_error("Unable to write header");
+  }
+};
+}
+
+#endif
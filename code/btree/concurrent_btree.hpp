@@ -0,0 +1,592 @@
+#ifndef CONCURRENT_BTREE_HPP
+#define CONCURRENT_BTREE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fixed_btree.hpp"
+
+namespace b {
+
+// b::fixed_node guarded by a version latch for optimistic lock coupling
+// readers record the version, read without latching and validate the version
+// afterwards; writers latch by bumping the version to an odd multiple of two
+template <typename T, int t>
+struct alignas(CACHE_LINE) olc_node {
+  static_assert(t >= 2, "minimum degree must be at least 2");
+
+  static const std::uint64_t OBSOLETE = 1, LOCKED = 2;
+
+  olc_node() : version(0), n(0), leaf(true) {
+    std::fill(children, children + 2 * t, nullptr);
+  }
+
+  static void* operator new(const std::size_t size) {
+    void* p;
+    if (posix_memalign(&p, CACHE_LINE, size)) throw std::bad_alloc();
+    return p;
+  }
+  static void operator delete(void* p) { free(p); }
+
+  std::uint64_t read_lock(bool& restart) const {
+    /* waits until the node is not latched.
+    - 'restart': set if the node was unlinked from the tree
+    - returns: version to validate optimistic reads against */
+
+    std::uint64_t v = version.load(std::memory_order_acquire);
+    while (v & LOCKED) {
+      std::this_thread::yield();
+      v = version.load(std::memory_order_acquire);
+    }
+    if (v & OBSOLETE) restart = true;
+    return v;
+  }
+
+  void check(const std::uint64_t v, bool& restart) const {
+    /* validates every read since version 'v' was recorded.
+    - 'restart': set if the node was modified meanwhile */
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version.load(std::memory_order_relaxed) != v) restart = true;
+  }
+
+  void upgrade(std::uint64_t v, bool& restart) {
+    /* latches the node if it is still at version 'v'.
+    - 'restart': set if it is not, in which case nothing is latched */
+
+    if (!version.compare_exchange_strong(v, v + LOCKED,
+                                         std::memory_order_acquire))
+      restart = true;
+    else
+      std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  bool try_latch() {
+    /* latches the node unless it is latched or unlinked.
+    - returns: whether it was latched */
+
+    bool restart = false;
+    std::uint64_t v = version.load(std::memory_order_acquire);
+    if (v & (LOCKED | OBSOLETE)) return false;
+    upgrade(v, restart);
+    return !restart;
+  }
+
+  void write_unlock() { version.fetch_add(LOCKED, std::memory_order_release); }
+
+  void write_unlock_obsolete() {
+    version.fetch_add(LOCKED | OBSOLETE, std::memory_order_release);
+  }
+
+  int size() const {
+    // optimistic reads may see a torn count, keep it within the arrays
+    return std::min(std::max((int)n, 0), 2 * t - 1);
+  }
+
+  // the following run with the node and the children involved latched
+
+  void split_child(const int i) {
+    olc_node* left = children[i];
+    olc_node* right = new olc_node();
+
+    // copy keys and children to right child
+    right->leaf = left->leaf;
+    right->n = t - 1;
+    std::copy(left->keys + t, left->keys + 2 * t - 1, right->keys);
+    if (!left->leaf)
+      std::copy(left->children + t, left->children + 2 * t, right->children);
+    left->n = t - 1;
+
+    // move median up
+    std::copy_backward(children + i + 1, children + n + 1, children + n + 2);
+    children[i + 1] = right;
+    std::copy_backward(keys + i, keys + n, keys + n + 1);
+    keys[i] = left->keys[t - 1];
+    n++;
+  }
+
+  void merge_right_left(const int i) {
+    // the right child is left for the caller to unlink
+    olc_node* left = children[i];
+    olc_node* right = children[i + 1];
+
+    // descend ith-key to be new median
+    left->keys[left->n] = keys[i];
+    std::copy(keys + i + 1, keys + n, keys + i);
+    std::copy(children + i + 2, children + n + 1, children + i + 1);
+    n--;
+
+    // append the keys and children of the right child to left's
+    std::copy(right->keys, right->keys + right->n, left->keys + left->n + 1);
+    if (!left->leaf)
+      std::copy(right->children, right->children + right->n + 1,
+                left->children + left->n + 1);
+    left->n += right->n + 1;
+  }
+
+  void rotate_left(const int i) {
+    // descend a key from current node to child i and replace it
+    // with leftmost key of its right sibling
+    olc_node* child = children[i];
+    olc_node* right = children[i + 1];
+    child->keys[child->n] = keys[i];
+    keys[i] = right->keys[0];
+    std::copy(right->keys + 1, right->keys + right->n, right->keys);
+
+    if (!child->leaf) {
+      // move right sibling's leftmost child to child i
+      child->children[child->n + 1] = right->children[0];
+      std::copy(right->children + 1, right->children + right->n + 1,
+                right->children);
+    }
+    child->n++;
+    right->n--;
+  }
+
+  void rotate_right(const int i) {
+    // descend a key from current node to child i and replace it
+    // with rightmost key of its left sibling
+    olc_node* child = children[i];
+    olc_node* left = children[i - 1];
+    std::copy_backward(child->keys, child->keys + child->n,
+                       child->keys + child->n + 1);
+    child->keys[0] = keys[i - 1];
+    keys[i - 1] = left->keys[left->n - 1];
+
+    if (!child->leaf) {
+      // move left sibling's rightmost child to child i
+      std::copy_backward(child->children, child->children + child->n + 1,
+                         child->children + child->n + 2);
+      child->children[0] = left->children[left->n];
+    }
+    child->n++;
+    left->n--;
+  }
+
+  std::atomic<std::uint64_t> version;
+  int n;
+  bool leaf;
+  T keys[2 * t - 1];
+  olc_node* children[2 * t];
+};
+
+// b::tree safe for concurrent readers and writers
+// searches latch nothing, writers latch only the nodes they modify and
+// restart from the root whenever a node they read changed underneath them
+// unlinked nodes may still be read by optimistic readers, so they are
+// retired with the current epoch and freed once every operation in progress
+// began in a later one
+template <typename T, int t>
+class concurrent_tree {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "optimistic readers may copy keys while they are written");
+
+  typedef olc_node<T, t> node;
+
+ public:
+  // operations announced at once, more wait for a free slot
+  static const int N_SLOTS = 64;
+
+  // retirements between attempts to free retired nodes
+  static const std::size_t RECLAIM_BATCH = 64;
+
+  concurrent_tree()
+      : root(new node()), epoch(1), next_reclaim(RECLAIM_BATCH) {}
+
+  ~concurrent_tree() {
+    destroy(root.load());
+    for (const std::pair<node*, std::uint64_t>& x : retired) delete x.first;
+  }
+
+  concurrent_tree(const concurrent_tree&) = delete;
+  concurrent_tree& operator=(const concurrent_tree&) = delete;
+
+  bool search(const T& key) const {
+    const announcement a(*this);
+    bool found;
+    while (!try_search(key, found)) {
+    }
+    return found;
+  }
+
+  void insert(const T& key) {
+    const announcement a(*this);
+    while (!try_insert(key)) {
+    }
+  }
+
+  bool erase(const T& key) {
+    /* returns: whether key was found */
+
+    const announcement a(*this);
+    bool erased;
+    while (!try_erase(key, erased)) {
+    }
+    return erased;
+  }
+
+  std::size_t reclaim() {
+    /* frees the retired nodes no operation in progress can reach, which is
+    all of them at a quiescent point.
+    - returns: number of retired nodes left */
+
+    std::lock_guard<std::mutex> guard(retired_lock);
+    return free_retired();
+  }
+
+  // not safe against concurrent writers
+  void collect(std::vector<T>& ret) const { collect(root.load(), ret); }
+
+  // not safe against concurrent writers
+  void print(std::ostream& stream) const { print(stream, root.load(), 0); }
+
+ private:
+  // epoch a thread's operation began in, 0 while the slot is free
+  struct alignas(CACHE_LINE) slot {
+    slot() : epoch(0) {}
+    std::atomic<std::uint64_t> epoch;
+  };
+
+  // holds a slot for the scope of an operation
+  class announcement {
+   public:
+    announcement(const concurrent_tree& tree) : s(tree.enter()) {}
+    ~announcement() { s->epoch.store(0, std::memory_order_release); }
+
+   private:
+    slot* s;
+  };
+
+  std::atomic<node*> root;
+
+  std::atomic<std::uint64_t> epoch;
+  mutable slot slots[N_SLOTS];
+
+  // unlinked nodes with the epoch they were unlinked in
+  std::mutex retired_lock;
+  std::vector<std::pair<node*, std::uint64_t>> retired;
+  std::size_t next_reclaim;
+
+  slot* enter() const {
+    /* claims a slot, starting from one picked by thread so threads rarely
+    share them, and announces the current epoch in it. */
+
+    std::size_t i = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (int tries = 1;; tries++, i++) {
+      slot& s = slots[i % N_SLOTS];
+      std::uint64_t free_slot = 0;
+      if (!s.epoch.load(std::memory_order_relaxed) &&
+          s.epoch.compare_exchange_strong(free_slot, epoch.load()))
+        return &s;
+      if (tries % N_SLOTS == 0) std::this_thread::yield();
+    }
+  }
+
+  void retire(node* x) {
+    std::lock_guard<std::mutex> guard(retired_lock);
+    retired.emplace_back(x, epoch.load());
+    if (retired.size() >= next_reclaim)
+      next_reclaim = free_retired() + RECLAIM_BATCH;
+  }
+
+  std::size_t free_retired() {
+    /* frees retired nodes unlinked before the oldest operation in progress
+    began, advancing the epoch so later operations do not hold back nodes
+    retired until now. runs with retired_lock held.
+    - returns: number of retired nodes left */
+
+    std::uint64_t oldest = epoch.fetch_add(1) + 1;
+    for (const slot& s : slots) {
+      const std::uint64_t e = s.epoch.load();
+      if (e && e < oldest) oldest = e;
+    }
+
+    std::size_t kept = 0;
+    for (const std::pair<node*, std::uint64_t>& x : retired)
+      if (x.second < oldest)
+        delete x.first;
+      else
+        retired[kept++] = x;
+    retired.resize(kept);
+    return kept;
+  }
+
+  static void destroy(node* x) {
+    if (!x->leaf)
+      for (int i = 0; i <= x->n; i++) destroy(x->children[i]);
+    delete x;
+  }
+
+  node* lock_root(std::uint64_t& v) const {
+    /* returns: current root with its version in 'v', or nullptr to restart */
+
+    bool restart = false;
+    node* x = root.load();
+    v = x->read_lock(restart);
+
+    // a root replaced before its version was read is no longer the root
+    if (restart || x != root.load()) return nullptr;
+    return x;
+  }
+
+  node* lock_child(const node* x, const std::uint64_t v, const int i,
+                   std::uint64_t& cv) const {
+    /* reads child 'i' of node 'x', read at version 'v'.
+    - returns: the child with its version in 'cv', or nullptr to restart */
+
+    bool restart = false;
+    node* child = x->children[i];
+    if (!child) return nullptr;
+    cv = child->read_lock(restart);
+
+    // the child is still reached through x only if x did not change
+    x->check(v, restart);
+    if (restart) return nullptr;
+    return child;
+  }
+
+  bool try_search(const T& key, bool& found) const {
+    std::uint64_t v;
+    const node* x = lock_root(v);
+    if (!x) return false;
+
+    for (;;) {
+      bool restart = false;
+      const int n = x->size();
+      const int i = position(x->keys, n, key, false);
+      const bool hit = (i < n && x->keys[i] == key);
+      if (hit || x->leaf) {
+        x->check(v, restart);
+        found = hit;
+        return !restart;
+      }
+
+      std::uint64_t cv;
+      x = lock_child(x, v, i, cv);
+      if (!x) return false;
+      v = cv;
+    }
+  }
+
+  bool try_insert(const T& key) {
+    bool restart = false;
+    std::uint64_t v;
+    node* x = lock_root(v);
+    if (!x) return false;
+
+    // if root is full, create new root and split old root
+    if (x->n == 2 * t - 1) {
+      x->upgrade(v, restart);
+      if (restart) return false;
+      node* r = new node();
+      r->leaf = false;
+      r->children[0] = x;
+      r->split_child(0);
+      root.store(r);
+      x->write_unlock();
+      return false;
+    }
+
+    for (;;) {
+      if (x->leaf) {
+        x->upgrade(v, restart);
+        if (restart) return false;
+
+        // shift greater keys to open room for key
+        const int i = position(x->keys, x->n, key, true);
+        std::copy_backward(x->keys + i, x->keys + x->n, x->keys + x->n + 1);
+        x->keys[i] = key;
+        x->n++;
+        x->write_unlock();
+        return true;
+      }
+
+      const int i = position(x->keys, x->size(), key, true);
+      std::uint64_t cv;
+      node* child = lock_child(x, v, i, cv);
+      if (!child) return false;
+
+      // if proper child is full, split it and start over, splits are rare
+      if (child->n == 2 * t - 1) {
+        x->upgrade(v, restart);
+        if (restart) return false;
+        child->upgrade(cv, restart);
+        if (!restart) {
+          x->split_child(i);
+          child->write_unlock();
+        }
+        x->write_unlock();
+        return false;
+      }
+
+      x = child;
+      v = cv;
+    }
+  }
+
+  bool try_erase(const T& key, bool& erased) {
+    bool restart = false;
+    std::uint64_t v;
+    node* x = lock_root(v);
+    if (!x) return false;
+
+    for (;;) {
+      const int n = x->size();
+      const int i = position(x->keys, n, key, false);
+      const bool hit = (i < n && x->keys[i] == key);
+
+      if (x->leaf) {
+        // if leaf, just erase it
+        x->upgrade(v, restart);
+        if (restart) return false;
+        if (hit) {
+          std::copy(x->keys + i + 1, x->keys + x->n, x->keys + i);
+          x->n--;
+        }
+        x->write_unlock();
+        erased = hit;
+        return true;
+      }
+
+      std::uint64_t cv;
+      node* child = lock_child(x, v, i, cv);
+      if (!child) return false;
+
+      // maintain every node with at least t keys while recursing down the tree
+      if (child->n < t) {
+        fix_child(x, v, i, child, cv);
+        return false;
+      }
+
+      if (hit) return erase_internal(x, v, i, child, cv, erased);
+      x = child;
+      v = cv;
+    }
+  }
+
+  bool erase_internal(node* x, const std::uint64_t v, const int i, node* y,
+                      std::uint64_t yv, bool& erased) {
+    /* replaces key i of node 'x', read at version 'v', by its predecessor,
+    which is the last key of the rightmost leaf below child 'y'.
+    - returns: false to restart */
+
+    // keep every node on the rightmost path with at least t keys
+    bool restart = false;
+    while (!y->leaf) {
+      const int n = y->size();
+      std::uint64_t zv;
+      node* z = lock_child(y, yv, n, zv);
+      if (!z) return false;
+      if (z->n < t) {
+        fix_child(y, yv, n, z, zv);
+        return false;
+      }
+      y = z;
+      yv = zv;
+    }
+
+    // the leaf is the predecessor's as long as neither node changed
+    x->upgrade(v, restart);
+    if (restart) return false;
+    y->upgrade(yv, restart);
+    if (restart) {
+      x->write_unlock();
+      return false;
+    }
+
+    x->keys[i] = y->keys[y->n - 1];
+    y->n--;
+    y->write_unlock();
+    x->write_unlock();
+    erased = true;
+    return true;
+  }
+
+  void fix_child(node* x, const std::uint64_t v, const int i, node* child,
+                 const std::uint64_t cv) {
+    /* brings child 'i' of node 'x' to t keys, borrowing a key from a sibling
+    or merging with one. 'x' was read at version 'v' and 'child' at 'cv'.
+    gives up if any node involved changed or is latched. */
+
+    bool restart = false;
+    x->upgrade(v, restart);
+    if (restart) return;
+    child->upgrade(cv, restart);
+    if (restart) {
+      x->write_unlock();
+      return;
+    }
+
+    node* right = (i < x->n ? x->children[i + 1] : nullptr);
+    node* left = (i > 0 ? x->children[i - 1] : nullptr);
+    const bool latched_right = (!right || right->try_latch());
+    if (!latched_right || (left && !left->try_latch())) {
+      if (right && latched_right) right->write_unlock();
+      child->write_unlock();
+      x->write_unlock();
+      return;
+    }
+
+    // same cases as b::node::erase
+    node* unlinked = nullptr;
+    if (right && right->n >= t)
+      x->rotate_left(i);
+    else if (left && left->n >= t)
+      x->rotate_right(i);
+    else if (right) {
+      x->merge_right_left(i);
+      unlinked = right;
+    } else {
+      x->merge_right_left(i - 1);
+      unlinked = child;
+    }
+
+    for (node* y : {left, child, right})
+      if (y && y != unlinked) y->write_unlock();
+    if (unlinked) {
+      unlinked->write_unlock_obsolete();
+      retire(unlinked);
+    }
+
+    // if root is emptied by merge, make merged child new root
+    if (!x->n) {
+      root.store(x->children[0]);
+      x->write_unlock_obsolete();
+      retire(x);
+    } else
+      x->write_unlock();
+  }
+
+  void collect(const node* x, std::vector<T>& ret) const {
+    // append keys in order
+    for (int i = 0; i < x->n; i++) {
+      if (!x->leaf) collect(x->children[i], ret);
+      ret.push_back(x->keys[i]);
+    }
+    if (!x->leaf) collect(x->children[x->n], ret);
+  }
+
+  void print(std::ostream& stream, const node* x, const int level) const {
+    for (int i = 0; i < level; i++) stream << " ";
+    stream << "[";
+    for (int i = 0; i < x->n; i++) {
+      stream << x->keys[i];
+      if (i < x->n - 1) stream << " ";
+    }
+    stream << "]" << std::endl;
+    if (!x->leaf)
+      for (int i = 0; i <= x->n; i++) print(stream, x->children[i], level + 1);
+  }
+};
+}
+
+#endif
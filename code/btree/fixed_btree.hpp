@@ -0,0 +1,323 @@
+#ifndef FIXED_BTREE_HPP
+#define FIXED_BTREE_HPP
+
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+namespace b {
+
+const std::size_t CACHE_LINE = 64;
+
+// position of key among the first n keys: the number of keys below it, or
+// not above it if upper is set
+// arithmetic keys use a branchless linear scan
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value, int>::type position(
+    const T* keys, const int n, const T& key, const bool upper) {
+  int ret = 0;
+  if (upper)
+    for (int i = 0; i < n; i++) ret += (keys[i] <= key);
+  else
+    for (int i = 0; i < n; i++) ret += (keys[i] < key);
+  return ret;
+}
+
+template <typename T>
+typename std::enable_if<!std::is_arithmetic<T>::value, int>::type position(
+    const T* keys, const int n, const T& key, const bool upper) {
+  return (upper ? std::upper_bound(keys, keys + n, key)
+                : std::lower_bound(keys, keys + n, key)) -
+         keys;
+}
+
+#ifdef __SSE2__
+// int keys are compared four at a time
+inline int position(const int* keys, const int n, const int& key,
+                    const bool upper) {
+  const __m128i k = _mm_set1_epi32(key);
+  __m128i count = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i x =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+    __m128i below = _mm_cmplt_epi32(x, k);
+    if (upper) below = _mm_or_si128(below, _mm_cmpeq_epi32(x, k));
+
+    // matching lanes are all ones, that is, -1
+    count = _mm_sub_epi32(count, below);
+  }
+
+  int lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), count);
+  int ret = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  for (; i < n; i++) ret += (upper ? keys[i] <= key : keys[i] < key);
+  return ret;
+}
+#endif
+
+// b::node with minimum degree t fixed at compile time, so keys and children
+// live inline in the node, which starts at a cache line
+template <typename T, int t>
+struct alignas(CACHE_LINE) fixed_node {
+  static_assert(t >= 2, "minimum degree must be at least 2");
+
+  fixed_node() : n(0), leaf(true) {}
+
+  ~fixed_node() {
+    if (!leaf)
+      for (int i = 0; i <= n; i++) delete children[i];
+  }
+
+  // new does not honor extended alignment before C++17
+  static void* operator new(const std::size_t size) {
+    void* p;
+    if (posix_memalign(&p, CACHE_LINE, size)) throw std::bad_alloc();
+    return p;
+  }
+  static void operator delete(void* p) { free(p); }
+
+  void split_child(const int i) {
+    fixed_node* left = children[i];
+    fixed_node* right = new fixed_node();
+
+    // copy keys and children to right child
+    right->leaf = left->leaf;
+    right->n = t - 1;
+    std::copy(left->keys + t, left->keys + 2 * t - 1, right->keys);
+    if (!left->leaf)
+      std::copy(left->children + t, left->children + 2 * t, right->children);
+    left->n = t - 1;
+
+    // move median up
+    std::copy_backward(children + i + 1, children + n + 1, children + n + 2);
+    children[i + 1] = right;
+    std::copy_backward(keys + i, keys + n, keys + n + 1);
+    keys[i] = left->keys[t - 1];
+    n++;
+  }
+
+  void insert(const T& key) {
+    int i = position(keys, n, key, true);
+
+    // if leaf, insert in it
+    // otherwise, continue insertion downwards
+    if (leaf) {
+      std::copy_backward(keys + i, keys + n, keys + n + 1);
+      keys[i] = key;
+      n++;
+    } else {
+      // if proper child is full, split it
+      if (children[i]->n == 2 * t - 1) {
+        split_child(i);
+
+        // find out which of the new children is proper
+        if (key > keys[i]) i++;
+      }
+
+      children[i]->insert(key);
+    }
+  }
+
+  bool search(const T& key) const {
+    const fixed_node* x = this;
+    for (;;) {
+      const int i = position(x->keys, x->n, key, false);
+      if (i < x->n && x->keys[i] == key) return true;
+      if (x->leaf) return false;
+      x = x->children[i];
+    }
+  }
+
+  void merge_right_left(const int i) {
+    fixed_node* left = children[i];
+    fixed_node* right = children[i + 1];
+
+    // descend ith-key to be new median
+    left->keys[left->n] = keys[i];
+    std::copy(keys + i + 1, keys + n, keys + i);
+    std::copy(children + i + 2, children + n + 1, children + i + 1);
+    n--;
+
+    // append the keys and children of the right child to left's
+    std::copy(right->keys, right->keys + right->n, left->keys + left->n + 1);
+    if (!left->leaf)
+      std::copy(right->children, right->children + right->n + 1,
+                left->children + left->n + 1);
+    left->n += right->n + 1;
+
+    // delete right child without its children
+    right->leaf = true;
+    delete right;
+  }
+
+  void erase(const T& key) {
+    const int i = position(keys, n, key, false);
+
+    if (i < n && keys[i] == key) {
+      if (leaf) {
+        // if leaf, just erase it
+        std::copy(keys + i + 1, keys + n, keys + i);
+        n--;
+      } else if (children[i]->n >= t) {
+        // replace key by its predecessor
+        const fixed_node* x = children[i];
+        while (!x->leaf) x = x->children[x->n];
+        const T replacement = x->keys[x->n - 1];
+        children[i]->erase(replacement);
+        keys[i] = replacement;
+
+      } else if (children[i + 1]->n >= t) {
+        // replace key by its successor
+        const fixed_node* x = children[i + 1];
+        while (!x->leaf) x = x->children[0];
+        const T replacement = x->keys[0];
+        children[i + 1]->erase(replacement);
+        keys[i] = replacement;
+
+      } else {
+        merge_right_left(i);
+
+        // recursively delete key from newly merged child
+        children[i]->erase(key);
+      }
+      return;
+    }
+
+    if (leaf) return;
+
+    // maintain every node with at least t keys while recursing down the tree
+    fixed_node* child = children[i];
+    if (child->n >= t)
+      child->erase(key);
+    else if (i < n && children[i + 1]->n >= t) {
+      fixed_node* right = children[i + 1];
+
+      // descend a key from current node to recursion node and replace it
+      // with leftmost key of recursion node's right sibling
+      child->keys[child->n] = keys[i];
+      keys[i] = right->keys[0];
+      std::copy(right->keys + 1, right->keys + right->n, right->keys);
+
+      if (!child->leaf) {
+        // move right sibling's leftmost child to recursion node
+        child->children[child->n + 1] = right->children[0];
+        std::copy(right->children + 1, right->children + right->n + 1,
+                  right->children);
+      }
+      child->n++;
+      right->n--;
+      child->erase(key);
+
+    } else if (i > 0 && children[i - 1]->n >= t) {
+      fixed_node* left = children[i - 1];
+
+      // descend a key from current node to recursion node and replace it
+      // with rightmost key of recursion node's left sibling
+      std::copy_backward(child->keys, child->keys + child->n,
+                         child->keys + child->n + 1);
+      child->keys[0] = keys[i - 1];
+      keys[i - 1] = left->keys[left->n - 1];
+
+      if (!child->leaf) {
+        // move left sibling's rightmost child to recursion node
+        std::copy_backward(child->children, child->children + child->n + 1,
+                           child->children + child->n + 2);
+        child->children[0] = left->children[left->n];
+      }
+      child->n++;
+      left->n--;
+      child->erase(key);
+
+    } else if (i < n) {
+      // merge recursion node with its right sibling
+      merge_right_left(i);
+      children[i]->erase(key);
+    } else {
+      // merge recursion node with its left sibling
+      merge_right_left(i - 1);
+      children[i - 1]->erase(key);
+    }
+  }
+
+  void collect(std::vector<T>& ret) const {
+    // append keys in order
+    for (int i = 0; i < n; i++) {
+      if (!leaf) children[i]->collect(ret);
+      ret.push_back(keys[i]);
+    }
+    if (!leaf) children[n]->collect(ret);
+  }
+
+  void print(std::ostream& stream, const int level) const {
+    for (int i = 0; i < level; i++) stream << " ";
+    stream << "[";
+    for (int i = 0; i < n; i++) {
+      stream << keys[i];
+      if (i < n - 1) stream << " ";
+    }
+    stream << "]" << std::endl;
+    if (!leaf)
+      for (int i = 0; i <= n; i++) children[i]->print(stream, level + 1);
+  }
+
+  int n;
+  bool leaf;
+  T keys[2 * t - 1];
+  fixed_node* children[2 * t];
+};
+
+template <typename T, int t>
+class fixed_tree {
+ public:
+  fixed_tree() { root = new fixed_node<T, t>(); }
+
+  ~fixed_tree() { delete root; }
+
+  fixed_tree(const fixed_tree&) = delete;
+  fixed_tree& operator=(const fixed_tree&) = delete;
+
+  bool search(const T& key) const { return root->search(key); }
+
+  void insert(const T& key) {
+    // if root is full, create new root and split old root
+    if (root->n == 2 * t - 1) {
+      fixed_node<T, t>* r = root;
+      root = new fixed_node<T, t>();
+      root->leaf = false;
+      root->children[0] = r;
+      root->split_child(0);
+    }
+
+    root->insert(key);
+  }
+
+  void erase(const T& key) {
+    root->erase(key);
+
+    // if root is emptied by deletion, make left child new root
+    if (!root->n && !root->leaf) {
+      fixed_node<T, t>* new_root = root->children[0];
+      root->leaf = true;
+      delete root;
+      root = new_root;
+    }
+  }
+
+  void collect(std::vector<T>& ret) const { root->collect(ret); }
+
+  void print(std::ostream& stream) const { root->print(stream, 0); }
+
+ private:
+  fixed_node<T, t>* root;
+};
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "btree.hpp"
+#include "btree_map.hpp"
+
+namespace {
+typedef std::chrono::steady_clock timer;
+
+double seconds_since(const timer::time_point& start) {
+  return std::chrono::duration<double>(timer::now() - start).count();
+}
+
+// uniform interface over the containers compared
+struct b_map {
+  b::map<int, int> m;
+  void insert(const int key) { m.insert(key, key); }
+  bool find(const int key) const { return m.find(key); }
+  void erase(const int key) { m.erase(key); }
+};
+
+struct std_map {
+  std::map<int, int> m;
+  void insert(const int key) { m.emplace(key, key); }
+  bool find(const int key) const { return m.find(key) != m.end(); }
+  void erase(const int key) { m.erase(key); }
+};
+
+struct std_set {
+  std::set<int> s;
+  void insert(const int key) { s.insert(key); }
+  bool find(const int key) const { return s.find(key) != s.end(); }
+  void erase(const int key) { s.erase(key); }
+};
+
+struct b_tree {
+  b_tree() : tr(16) {}
+  b::tree<int> tr;
+  void insert(const int key) { tr.insert(key); }
+  bool find(const int key) const { return tr.search(key); }
+  void erase(const int key) { tr.erase(key); }
+};
+
+template <typename C>
+void run(const std::string& name, const std::vector<int>& keys,
+         const std::vector<int>& lookups) {
+  /* times inserting 'keys', finding 'lookups' and erasing 'keys' again. */
+
+  C c;
+  timer::time_point start = timer::now();
+  for (const int key : keys) c.insert(key);
+  const double insert = seconds_since(start);
+
+  start = timer::now();
+  int found = 0;
+  for (const int key : lookups) found += c.find(key);
+  const double find = seconds_since(start);
+
+  start = timer::now();
+  for (const int key : keys) c.erase(key);
+  const double erase = seconds_since(start);
+
+  const double n = keys.size();
+  std::cout << name << "\tinsert " << insert / n * 1e9 << " ns\tfind "
+            << find / lookups.size() * 1e9 << " ns\terase " << erase / n * 1e9
+            << " ns\t(" << found << " found)" << std::endl;
+}
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " n_keys" << std::endl;
+    return 1;
+  }
+  const int n = std::atoi(argv[1]);
+
+  // distinct random keys, looked up half hits and half misses
+  std::mt19937 rng(42);
+  std::vector<int> keys(2 * n);
+  for (int i = 0; i < 2 * n; i++) keys[i] = 2 * i;
+  std::shuffle(keys.begin(), keys.end(), rng);
+  std::vector<int> lookups(keys.begin() + n, keys.end());
+  keys.resize(n);
+  for (int i = 0; i < n; i += 2) lookups[i] = keys[i];
+  std::shuffle(lookups.begin(), lookups.end(), rng);
+
+  std::cout << n << " keys" << std::endl;
+  run<b_map>("b::map", keys, lookups);
+  run<b_tree>("b::tree", keys, lookups);
+  run<std_map>("std::map", keys, lookups);
+  run<std_set>("std::set", keys, lookups);
+}
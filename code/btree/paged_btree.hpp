@@ -0,0 +1,348 @@
+#ifndef PAGED_BTREE_HPP
+#define PAGED_BTREE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "buffer_manager.hpp"
+
+namespace b {
+
+// b::tree whose nodes are pages of a file, accessed through a buffer manager
+// t is the largest minimum degree whose node fits a page
+template <typename T, std::size_t PageSize = 4096>
+class paged_tree {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "paged_tree keys are copied to and from pages byte by byte");
+
+ public:
+  static const int t = (PageSize - 8 + sizeof(T)) / (8 + 2 * sizeof(T));
+  static_assert(t >= 2, "PageSize too small for key type");
+
+  paged_tree(const std::string& file_name, const std::size_t n_frames = 64)
+      : pages(file_name, PageSize, n_frames) {
+    // create empty root leaf in new files
+    if (pages.get_root() == buffer_manager::NIL) {
+      const std::uint32_t root = pages.allocate();
+      node* x = reinterpret_cast<node*>(pages.pin(root));
+      x->leaf = 1;
+      pages.unpin(root, true);
+      pages.unpin(root, true);
+      pages.set_root(root);
+    }
+  }
+
+  bool search(const T& key) const {
+    std::uint32_t id = pages.get_root();
+    for (;;) {
+      const node* x = pin(id);
+      const int i = std::lower_bound(x->keys, x->keys + x->n, key) - x->keys;
+      const bool found = (i < (int)x->n && x->keys[i] == key);
+      const std::uint32_t next = (x->leaf || found ? buffer_manager::NIL
+                                                   : x->children[i]);
+      pages.unpin(id, false);
+
+      if (next == buffer_manager::NIL) return found;
+      id = next;
+    }
+  }
+
+  void insert(const T& key) {
+    // if root is full, create new root and split old root
+    std::uint32_t root = pages.get_root();
+    node* r = pin(root);
+    const bool full = (r->n == 2 * t - 1);
+    pages.unpin(root, false);
+    if (full) {
+      const std::uint32_t new_root = pages.allocate();
+      node* x = pin(new_root);
+      pages.unpin(new_root, false);
+      x->children[0] = root;
+      split_child(x, 0);
+      pages.unpin(new_root, true);
+      pages.set_root(root = new_root);
+    }
+
+    // descend splitting full children
+    std::uint32_t id = root;
+    for (;;) {
+      node* x = pin(id);
+      int i = std::upper_bound(x->keys, x->keys + x->n, key) - x->keys;
+      if (x->leaf) {
+        // shift greater keys to open room for key
+        std::copy_backward(x->keys + i, x->keys + x->n, x->keys + x->n + 1);
+        x->keys[i] = key;
+        x->n++;
+        pages.unpin(id, true);
+        return;
+      }
+
+      node* child = pin(x->children[i]);
+      const bool child_full = (child->n == 2 * t - 1);
+      pages.unpin(x->children[i], false);
+      if (child_full) {
+        split_child(x, i);
+
+        // find out which of the new children is proper
+        if (key > x->keys[i]) i++;
+      }
+
+      const std::uint32_t next = x->children[i];
+      pages.unpin(id, child_full);
+      id = next;
+    }
+  }
+
+  void erase(const T& key) {
+    const std::uint32_t root = pages.get_root();
+    erase(root, key);
+
+    // if root is emptied by deletion, make left child new root
+    node* r = pin(root);
+    if (!r->n && !r->leaf) {
+      pages.set_root(r->children[0]);
+      pages.unpin(root, false);
+      pages.release(root);
+    } else
+      pages.unpin(root, false);
+  }
+
+  void collect(std::vector<T>& ret) const { collect(pages.get_root(), ret); }
+
+  void print(std::ostream& stream) const { print(stream, pages.get_root(), 0); }
+
+  void flush() { pages.flush(); }
+
+  const buffer_manager& get_pages() const { return pages; }
+
+ private:
+  struct node {
+    std::uint32_t n, leaf;
+    std::uint32_t children[2 * t];
+    T keys[2 * t - 1];
+  };
+  static_assert(sizeof(node) <= PageSize, "node does not fit a page");
+
+  mutable buffer_manager pages;
+
+  node* pin(const std::uint32_t id) const {
+    return reinterpret_cast<node*>(pages.pin(id));
+  }
+
+  void split_child(node* x, const int i) {
+    /* splits full child i of pinned node 'x' around its median. */
+
+    const std::uint32_t left_id = x->children[i];
+    node* left = pin(left_id);
+    const std::uint32_t right_id = pages.allocate();
+    node* right = pin(right_id);
+    pages.unpin(right_id, true);
+
+    // copy keys and children to right child
+    right->leaf = left->leaf;
+    right->n = t - 1;
+    std::copy(left->keys + t, left->keys + 2 * t - 1, right->keys);
+    if (!left->leaf)
+      std::copy(left->children + t, left->children + 2 * t, right->children);
+    left->n = t - 1;
+
+    // move median up
+    std::copy_backward(x->children + i + 1, x->children + x->n + 1,
+                       x->children + x->n + 2);
+    x->children[i + 1] = right_id;
+    std::copy_backward(x->keys + i, x->keys + x->n, x->keys + x->n + 1);
+    x->keys[i] = left->keys[t - 1];
+    x->n++;
+
+    pages.unpin(right_id, true);
+    pages.unpin(left_id, true);
+  }
+
+  void merge_right_left(node* x, const int i) {
+    /* merges child i + 1 of pinned node 'x' into child i, descending the ith
+    key as their median. */
+
+    const std::uint32_t left_id = x->children[i], right_id = x->children[i + 1];
+    node* left = pin(left_id);
+    node* right = pin(right_id);
+
+    // descend ith-key to be new median
+    left->keys[left->n] = x->keys[i];
+    std::copy(x->keys + i + 1, x->keys + x->n, x->keys + i);
+    std::copy(x->children + i + 2, x->children + x->n + 1, x->children + i + 1);
+    x->n--;
+
+    // append the keys and children of the right child to left's
+    std::copy(right->keys, right->keys + right->n, left->keys + left->n + 1);
+    if (!left->leaf)
+      std::copy(right->children, right->children + right->n + 1,
+                left->children + left->n + 1);
+    left->n += right->n + 1;
+
+    pages.unpin(right_id, false);
+    pages.release(right_id);
+    pages.unpin(left_id, true);
+  }
+
+  T extreme_key(std::uint32_t id, const bool rightmost) const {
+    /* returns: smallest or largest key in the subtree rooted at page 'id' */
+
+    for (;;) {
+      const node* x = pin(id);
+      if (x->leaf) {
+        const T key = (rightmost ? x->keys[x->n - 1] : x->keys[0]);
+        pages.unpin(id, false);
+        return key;
+      }
+      const std::uint32_t next = x->children[rightmost ? x->n : 0];
+      pages.unpin(id, false);
+      id = next;
+    }
+  }
+
+  void erase(const std::uint32_t id, const T& key) {
+    node* x = pin(id);
+    const int i = std::lower_bound(x->keys, x->keys + x->n, key) - x->keys;
+
+    if (i < (int)x->n && x->keys[i] == key) {
+      if (x->leaf) {
+        // if leaf, just erase it
+        std::copy(x->keys + i + 1, x->keys + x->n, x->keys + i);
+        x->n--;
+        pages.unpin(id, true);
+        return;
+      }
+
+      const std::uint32_t left_id = x->children[i],
+                          right_id = x->children[i + 1];
+      if (size(left_id) >= t) {
+        // replace key by its predecessor
+        const T replacement = extreme_key(left_id, true);
+        x->keys[i] = replacement;
+        pages.unpin(id, true);
+        erase(left_id, replacement);
+
+      } else if (size(right_id) >= t) {
+        // replace key by its successor
+        const T replacement = extreme_key(right_id, false);
+        x->keys[i] = replacement;
+        pages.unpin(id, true);
+        erase(right_id, replacement);
+
+      } else {
+        merge_right_left(x, i);
+        pages.unpin(id, true);
+
+        // recursively delete key from newly merged child
+        erase(left_id, key);
+      }
+      return;
+    }
+
+    if (x->leaf) {
+      pages.unpin(id, false);
+      return;
+    }
+
+    // maintain every node with at least t keys while recursing down the tree
+    int j = i;
+    if (size(x->children[i]) < t) {
+      node* child = pin(x->children[i]);
+      if (i < (int)x->n && size(x->children[i + 1]) >= t) {
+        node* right = pin(x->children[i + 1]);
+
+        // descend a key from current node to recursion node and replace it
+        // with leftmost key of recursion node's right sibling
+        child->keys[child->n] = x->keys[i];
+        x->keys[i] = right->keys[0];
+        std::copy(right->keys + 1, right->keys + right->n, right->keys);
+
+        if (!child->leaf) {
+          // move right sibling's leftmost child to recursion node
+          child->children[child->n + 1] = right->children[0];
+          std::copy(right->children + 1, right->children + right->n + 1,
+                    right->children);
+        }
+        child->n++;
+        right->n--;
+        pages.unpin(x->children[i + 1], true);
+        pages.unpin(x->children[i], true);
+
+      } else if (i > 0 && size(x->children[i - 1]) >= t) {
+        node* left = pin(x->children[i - 1]);
+
+        // descend a key from current node to recursion node and replace it
+        // with rightmost key of recursion node's left sibling
+        std::copy_backward(child->keys, child->keys + child->n,
+                           child->keys + child->n + 1);
+        child->keys[0] = x->keys[i - 1];
+        x->keys[i - 1] = left->keys[left->n - 1];
+
+        if (!child->leaf) {
+          // move left sibling's rightmost child to recursion node
+          std::copy_backward(child->children, child->children + child->n + 1,
+                             child->children + child->n + 2);
+          child->children[0] = left->children[left->n];
+        }
+        child->n++;
+        left->n--;
+        pages.unpin(x->children[i - 1], true);
+        pages.unpin(x->children[i], true);
+
+      } else {
+        pages.unpin(x->children[i], false);
+
+        // merge recursion node with a sibling, descending a key from the
+        // current node
+        if (i < (int)x->n)
+          merge_right_left(x, i);
+        else
+          merge_right_left(x, --j);
+      }
+    }
+
+    const std::uint32_t next = x->children[j];
+    pages.unpin(id, true);
+    erase(next, key);
+  }
+
+  int size(const std::uint32_t id) const {
+    const int n = pin(id)->n;
+    pages.unpin(id, false);
+    return n;
+  }
+
+  void collect(const std::uint32_t id, std::vector<T>& ret) const {
+    // append keys in order, keeping one page pinned per level
+    const node* x = pin(id);
+    for (int i = 0; i < (int)x->n; i++) {
+      if (!x->leaf) collect(x->children[i], ret);
+      ret.push_back(x->keys[i]);
+    }
+    if (!x->leaf) collect(x->children[x->n], ret);
+    pages.unpin(id, false);
+  }
+
+  void print(std::ostream& stream, const std::uint32_t id,
+             const int level) const {
+    const node* x = pin(id);
+    for (int i = 0; i < level; i++) stream << " ";
+    stream << "[";
+    for (int i = 0; i < (int)x->n; i++) {
+      stream << x->keys[i];
+      if (i < (int)x->n - 1) stream << " ";
+    }
+    stream << "]" << std::endl;
+    if (!x->leaf)
+      for (int i = 0; i <= (int)x->n; i++)
+        print(stream, x->children[i], level + 1);
+    pages.unpin(id, false);
+  }
+};
+}
+
+#endif
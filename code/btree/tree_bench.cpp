@@ -0,0 +1,989 @@
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "btree.hpp"
+#include "btree_image.hpp"
+#include "bplus_tree.hpp"
+#include "btree_map.hpp"
+#include "concurrent_btree.hpp"
+#include "fixed_btree.hpp"
+#include "paged_btree.hpp"
+
+namespace {
+typedef std::chrono::steady_clock timer;
+
+double seconds_since(const timer::time_point& start) {
+  return std::chrono::duration<double>(timer::now() - start).count();
+}
+
+std::size_t heap_in_use() { return mallinfo2().uordblks; }
+
+std::vector<int> make_keys(const std::string& order, const int n,
+                           std::mt19937& rng) {
+  /* generates 'n' keys: distinct in random, sorted or reverse 'order', or
+  zipfian with exponent 0.99 over n distinct keys. */
+
+  std::vector<int> keys(n);
+  if (order == "zipfian") {
+    // sample ranks from the cumulative distribution, scattering them
+    // over the key space so popular keys are not adjacent
+    std::vector<double> cdf(n);
+    double sum = 0;
+    for (int i = 0; i < n; i++) cdf[i] = (sum += 1 / std::pow(i + 1, 0.99));
+    std::uniform_real_distribution<double> u(0, sum);
+    for (int& key : keys)
+      key = (std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin()) *
+            2654435761u;
+    return keys;
+  }
+
+  for (int i = 0; i < n; i++) keys[i] = 2 * i;
+  if (order == "random")
+    std::shuffle(keys.begin(), keys.end(), rng);
+  else if (order == "reverse")
+    std::reverse(keys.begin(), keys.end());
+  return keys;
+}
+
+struct shape {
+  int height, nodes;
+  long long keys;
+};
+
+shape validate(const b::node<int>* x, const int* lo, const int* hi,
+               const int t, const bool root) {
+  /* checks every b::tree invariant below node 'x', whose keys must lie
+  within ['lo', 'hi'] where given. throws std::runtime_error on violation.
+  - returns: height, node count and key count of the subtree */
+
+  const int n = x->keys.size();
+  if ((!root && n < t - 1) || n > 2 * t - 1)
+    throw std::runtime_error("Node with " + std::to_string(n) + " keys");
+  if (!std::is_sorted(x->keys.begin(), x->keys.end()))
+    throw std::runtime_error("Unsorted node");
+  if (n && ((lo && x->keys[0] < *lo) || (hi && x->keys[n - 1] > *hi)))
+    throw std::runtime_error("Key out of its subtree's range");
+  if (!x->children.empty() && (int)x->children.size() != n + 1)
+    throw std::runtime_error("Node with " + std::to_string(n) + " keys and " +
+                             std::to_string(x->children.size()) + " children");
+
+  shape ret = {0, 1, n};
+  for (int i = 0; i < (int)x->children.size(); i++) {
+    const shape child = validate(x->children[i], i ? &x->keys[i - 1] : lo,
+                                 i < n ? &x->keys[i] : hi, t, false);
+    if (i && child.height != ret.height - 1)
+      throw std::runtime_error("Leaves at different depths");
+    ret.height = child.height + 1;
+    ret.nodes += child.nodes;
+    ret.keys += child.keys;
+  }
+  if (ret.keys != x->size)
+    throw std::runtime_error("Subtree size " + std::to_string(x->size) +
+                             " counted as " + std::to_string(ret.keys));
+  return ret;
+}
+
+void check(const int t, const int n_ops, std::mt19937& rng) {
+  /* runs 'n_ops' random operations on a b::tree of minimum degree 't' and
+  a std::multiset, validating the tree and comparing both along the way. */
+
+  b::tree<int> tree(t);
+  std::multiset<int> reference;
+  std::uniform_int_distribution<int> key(0, n_ops / 4), op(0, 9);
+  for (int i = 1; i <= n_ops; i++) {
+    const int k = key(rng);
+    switch (op(rng)) {
+      case 0:
+      case 1:
+      case 2:
+      case 3:
+        tree.insert(k);
+        reference.insert(k);
+        break;
+      case 4:
+      case 5:
+      case 6: {
+        tree.erase(k);
+        std::multiset<int>::iterator it = reference.find(k);
+        if (it != reference.end()) reference.erase(it);
+        break;
+      }
+      case 7:
+        if (tree.search(k) != (reference.count(k) > 0))
+          throw std::runtime_error("Wrong search of " + std::to_string(k));
+        break;
+      case 8:
+        if (tree.rank(k) !=
+            std::distance(reference.begin(), reference.lower_bound(k)))
+          throw std::runtime_error("Wrong rank of " + std::to_string(k));
+        break;
+      default:
+        if (!reference.empty()) {
+          const int r = std::uniform_int_distribution<int>(
+              0, reference.size() - 1)(rng);
+          if (tree.select(r) != *std::next(reference.begin(), r))
+            throw std::runtime_error("Wrong select of " + std::to_string(r));
+        }
+    }
+
+    if (i % 1000 == 0 || i == n_ops) {
+      validate(tree.get_root(), nullptr, nullptr, t, true);
+      std::vector<int> keys;
+      tree.get_root()->collect(keys);
+      if (!std::equal(keys.begin(), keys.end(), reference.begin()) ||
+          keys.size() != reference.size())
+        throw std::runtime_error("Keys differ from reference");
+    }
+  }
+
+  // rebuild from the reference and merge a sorted batch into it
+  std::vector<int> keys(reference.begin(), reference.end());
+  tree.bulk_load(keys.begin(), keys.end(), 0.7);
+  validate(tree.get_root(), nullptr, nullptr, t, true);
+  std::vector<int> batch(n_ops / 10);
+  for (int& k : batch) k = key(rng);
+  std::sort(batch.begin(), batch.end());
+  tree.merge(batch.begin(), batch.end());
+  if (validate(tree.get_root(), nullptr, nullptr, t, true).keys !=
+      (long long)(keys.size() + batch.size()))
+    throw std::runtime_error("Keys lost by bulk load or merge");
+
+  // round trip through an image, both loaded and mapped
+  const char* file_name = "tree_bench.image";
+  {
+    std::ofstream out(file_name, std::ios::binary);
+    tree.save(out);
+  }
+  b::tree<int> loaded(t);
+  std::ifstream in(file_name, std::ios::binary);
+  loaded.load(in);
+  const b::image<int> mapped(file_name);
+  std::remove(file_name);
+
+  validate(loaded.get_root(), nullptr, nullptr, t, true);
+  std::vector<int> saved_keys, loaded_keys;
+  tree.get_root()->collect(saved_keys);
+  loaded.get_root()->collect(loaded_keys);
+  if (saved_keys != loaded_keys || mapped.size() != tree.size())
+    throw std::runtime_error("Keys differ after loading image");
+  for (int i = 0; i < n_ops / 10; i++) {
+    const int k = key(rng);
+    const int r = std::uniform_int_distribution<int>(0, tree.size() - 1)(rng);
+    if (mapped.search(k) != tree.search(k) || mapped.rank(k) != tree.rank(k) ||
+        mapped.select(r) != tree.select(r))
+      throw std::runtime_error("Mapped image differs at " + std::to_string(k));
+  }
+}
+
+void check_ranges(const int t, const int n_ops, std::mt19937& rng) {
+  /* erases random ranges from a b::tree of minimum degree 't' and inserts
+  sorted batches into it, empty, single-key and whole-tree ones included,
+  comparing it with a std::multiset after each. */
+
+  b::tree<int> tree(t);
+  std::multiset<int> reference;
+  const int max_key = n_ops / 4;
+  std::uniform_int_distribution<int> key(-1, max_key + 1), shape(0, 9);
+  for (int i = 0; i < 200; i++) {
+    const int s = shape(rng);
+    if (s < 5) {
+      // a third of the batches are empty or a single key
+      std::vector<int> batch(s == 0 ? 0 : s == 1 ? 1 : n_ops / 200);
+      for (int& k : batch) k = key(rng);
+      std::sort(batch.begin(), batch.end());
+      tree.insert_sorted(batch.begin(), batch.end());
+      reference.insert(batch.begin(), batch.end());
+    } else {
+      // empty or inverted, single key, whole tree or random range
+      int lo = key(rng), hi = key(rng);
+      if (s == 5)
+        hi = lo - std::uniform_int_distribution<int>(0, 1)(rng);
+      else if (s == 6)
+        hi = lo + 1;
+      else if (s == 7) {
+        lo = -1;
+        hi = max_key + 2;
+      } else if (hi < lo)
+        std::swap(lo, hi);
+
+      int expected = 0;
+      if (lo < hi) {
+        const std::multiset<int>::iterator first = reference.lower_bound(lo),
+                                           last = reference.lower_bound(hi);
+        expected = std::distance(first, last);
+        reference.erase(first, last);
+      }
+      const int erased = tree.erase_range(lo, hi);
+      if (erased != expected)
+        throw std::runtime_error(
+            "Erased " + std::to_string(erased) + " keys from [" +
+            std::to_string(lo) + ", " + std::to_string(hi) + ") instead of " +
+            std::to_string(expected));
+    }
+
+    validate(tree.get_root(), nullptr, nullptr, t, true);
+    std::vector<int> keys;
+    tree.get_root()->collect(keys);
+    if (keys.size() != reference.size() ||
+        !std::equal(keys.begin(), keys.end(), reference.begin()))
+      throw std::runtime_error("Keys differ from reference after range");
+  }
+}
+
+void count_holders(const b::node<int>* x,
+                   std::map<const b::node<int>*, int>& holders) {
+  /* adds one holder to 'x' and, on its first, one to each of its children. */
+
+  if (holders[x]++) return;
+  for (const b::node<int>* child : x->children) count_holders(child, holders);
+}
+
+void check_unshared(const b::tree<int>& tree) {
+  /* throws std::runtime_error if a node of 'tree' is still held by anything
+  else, as after every snapshot of it is released. */
+
+  std::map<const b::node<int>*, int> holders;
+  count_holders(tree.get_root(), holders);
+  for (const std::pair<const b::node<int>* const, int>& x : holders)
+    if (x.second != 1 || x.first->refs.load() != 1)
+      throw std::runtime_error("Node still shared with a released snapshot");
+}
+
+void check_snapshots(const int t, const int n_ops, std::mt19937& rng) {
+  /* takes snapshots of a b::tree of minimum degree 't' while it changes,
+  checking each still matches the keys it was taken with, that every node
+  counts exactly its holders, and that none stays shared once they are
+  released. */
+
+  b::tree<int> tree(t);
+  std::multiset<int> reference;
+  std::uniform_int_distribution<int> key(0, n_ops / 4), op(0, 2);
+  for (int round = 0; round < 10; round++) {
+    check_unshared(tree);
+    const b::snapshot<int> frozen = tree.snapshot();
+    const b::node<int>* frozen_root = tree.get_root();
+    const std::vector<int> frozen_keys(reference.begin(), reference.end());
+
+    for (int i = 0; i < n_ops / 10; i++) {
+      const int k = key(rng);
+      if (op(rng)) {
+        tree.insert(k);
+        reference.insert(k);
+      } else {
+        tree.erase(k);
+        std::multiset<int>::iterator it = reference.find(k);
+        if (it != reference.end()) reference.erase(it);
+      }
+    }
+
+    // the snapshot is unaffected and so are copies of it
+    const b::snapshot<int> copy = frozen;
+    std::vector<int> keys;
+    copy.collect(keys);
+    if (keys != frozen_keys || frozen.size() != (int)frozen_keys.size())
+      throw std::runtime_error("Snapshot changed with the tree");
+    for (int i = 0; i < 100 && !frozen_keys.empty(); i++) {
+      const int k = key(rng);
+      const int r =
+          std::uniform_int_distribution<int>(0, frozen_keys.size() - 1)(rng);
+      if (frozen.search(k) !=
+              std::binary_search(frozen_keys.begin(), frozen_keys.end(), k) ||
+          frozen.rank(k) !=
+              std::lower_bound(frozen_keys.begin(), frozen_keys.end(), k) -
+                  frozen_keys.begin() ||
+          frozen.select(r) != frozen_keys[r])
+        throw std::runtime_error("Snapshot query differs at " +
+                                 std::to_string(k));
+    }
+
+    keys.clear();
+    tree.get_root()->collect(keys);
+    validate(tree.get_root(), nullptr, nullptr, t, true);
+    if (keys.size() != reference.size() ||
+        !std::equal(keys.begin(), keys.end(), reference.begin()))
+      throw std::runtime_error("Keys differ from reference under snapshot");
+
+    // the tree and both snapshots hold their roots, parents their children
+    std::map<const b::node<int>*, int> holders;
+    count_holders(tree.get_root(), holders);
+    count_holders(frozen_root, holders);
+    count_holders(frozen_root, holders);
+    for (const std::pair<const b::node<int>* const, int>& x : holders)
+      if (x.first->refs.load() != x.second)
+        throw std::runtime_error(
+            "Node counts " + std::to_string(x.first->refs.load()) +
+            " holders instead of " + std::to_string(x.second));
+  }
+  check_unshared(tree);
+}
+
+void check_bplus(const int t, const int n_ops, std::mt19937& rng) {
+  /* runs 'n_ops' random operations on a bplus_tree of minimum degree 't' and
+  a std::set, comparing results, lower bounds and the keys listed by the
+  linked leaves. */
+
+  b::bplus_tree<int> tree(t);
+  std::set<int> reference;
+  std::uniform_int_distribution<int> key(0, n_ops / 4), op(0, 9);
+  for (int i = 1; i <= n_ops; i++) {
+    const int k = key(rng);
+    const int o = op(rng);
+    if (o < 4) {
+      if (tree.insert(k) != reference.insert(k).second)
+        throw std::runtime_error("Wrong B+ insert of " + std::to_string(k));
+    } else if (o < 7) {
+      if (tree.erase(k) != (reference.erase(k) > 0))
+        throw std::runtime_error("Wrong B+ erase of " + std::to_string(k));
+    } else if (o < 8) {
+      if (tree.search(k) != (reference.count(k) > 0))
+        throw std::runtime_error("Wrong B+ search of " + std::to_string(k));
+    } else {
+      // lower bound and the few keys after it
+      b::bplus_tree<int>::iterator it = tree.lower_bound(k);
+      std::set<int>::iterator ref = reference.lower_bound(k);
+      for (int j = 0; j < 4 && ref != reference.end(); j++, ++it, ++ref)
+        if (it == tree.end() || *it != *ref)
+          throw std::runtime_error("Wrong B+ lower bound of " +
+                                   std::to_string(k));
+      if (ref == reference.end() && it != tree.end())
+        throw std::runtime_error("B+ keys past " + std::to_string(k));
+    }
+
+    if (i % 1000 == 0 || i == n_ops) {
+      std::vector<int> keys(tree.begin(), tree.end());
+      if (keys.size() != reference.size() ||
+          !std::equal(keys.begin(), keys.end(), reference.begin()))
+        throw std::runtime_error("B+ leaves differ from reference");
+    }
+  }
+}
+
+template <int t>
+void check_fixed_tree(const int n_ops, std::mt19937& rng) {
+  /* runs 'n_ops' random operations on a fixed_tree of minimum degree 't'
+  and a std::multiset, comparing both along the way. */
+
+  b::fixed_tree<int, t> tree;
+  std::multiset<int> reference;
+  std::uniform_int_distribution<int> key(0, n_ops / 4), op(0, 9);
+  for (int i = 1; i <= n_ops; i++) {
+    const int k = key(rng);
+    const int o = op(rng);
+    if (o < 4) {
+      tree.insert(k);
+      reference.insert(k);
+    } else if (o < 7) {
+      tree.erase(k);
+      std::multiset<int>::iterator it = reference.find(k);
+      if (it != reference.end()) reference.erase(it);
+    } else if (tree.search(k) != (reference.count(k) > 0))
+      throw std::runtime_error("Wrong fixed search of " + std::to_string(k));
+
+    if (i % 1000 == 0 || i == n_ops) {
+      std::vector<int> keys;
+      tree.collect(keys);
+      if (keys.size() != reference.size() ||
+          !std::equal(keys.begin(), keys.end(), reference.begin()))
+        throw std::runtime_error("Fixed keys differ from reference");
+    }
+  }
+}
+
+template <int t>
+int validate_map(const b::map_node<int, std::string, t>* x, const int* lo,
+                 const int* hi, const bool root, std::size_t& n_keys) {
+  /* checks b::map node 'x' and its subtree: key counts, key order within
+  (lo, hi) and leaves at the same depth.
+  - 'n_keys': incremented by the keys of the subtree
+  - returns: height of the subtree */
+
+  if (x->n > 2 * t - 1 || (!root && x->n < t - 1))
+    throw std::runtime_error("Map node with " + std::to_string(x->n) +
+                             " keys");
+  for (int i = 0; i < x->n; i++)
+    if ((i > 0 && !(x->keys[i - 1] < x->keys[i])) ||
+        (lo && !(*lo < x->keys[i])) || (hi && !(x->keys[i] < *hi)))
+      throw std::runtime_error("Map keys out of order at " +
+                               std::to_string(x->keys[i]));
+  n_keys += x->n;
+  if (x->leaf) return 0;
+
+  int height = -1;
+  for (int i = 0; i <= x->n; i++) {
+    const int h = validate_map<t>(x->children[i], i ? &x->keys[i - 1] : lo,
+                                  i < x->n ? &x->keys[i] : hi, false, n_keys);
+    if (height >= 0 && h != height)
+      throw std::runtime_error("Map leaves at different depths");
+    height = h;
+  }
+  return height + 1;
+}
+
+template <int t>
+void compare_map(const b::map<int, std::string, t>& map,
+                 const std::map<int, std::string>& reference) {
+  /* throws std::runtime_error unless 'map' is valid and holds the entries
+  of 'reference'. */
+
+  std::size_t n_keys = 0;
+  validate_map<t>(map.get_root(), nullptr, nullptr, true, n_keys);
+  std::vector<std::pair<int, std::string>> entries;
+  map.collect(entries);
+  if (n_keys != reference.size() || map.size() != reference.size() ||
+      entries != std::vector<std::pair<int, std::string>>(reference.begin(),
+                                                          reference.end()))
+    throw std::runtime_error("Map entries differ from reference");
+}
+
+template <int t>
+void check_map(const int n_ops, std::mt19937& rng) {
+  /* runs 'n_ops' random operations on a b::map of minimum degree 't' and a
+  std::map, with string values so entries are moved around, comparing both
+  along the way, then moves and clears it. */
+
+  b::map<int, std::string, t> map;
+  std::map<int, std::string> reference;
+  std::uniform_int_distribution<int> key(0, n_ops / 4), op(0, 9);
+  for (int i = 1; i <= n_ops; i++) {
+    int k = key(rng);
+    const int o = op(rng);
+    if (o < 3) {
+      const std::string value = std::to_string(i);
+      if (map.insert(k, value) != reference.emplace(k, value).second)
+        throw std::runtime_error("Wrong map insert of " + std::to_string(k));
+    } else if (o < 4) {
+      // new keys map to an empty string first
+      map[k] += "+";
+      reference[k] += "+";
+    } else if (o < 6) {
+      if (map.erase(k) != (reference.erase(k) > 0))
+        throw std::runtime_error("Wrong map erase of " + std::to_string(k));
+    } else if (o < 7) {
+      // keys of internal nodes are replaced by their predecessors
+      const b::map_node<int, std::string, t>* root = map.get_root();
+      if (root->leaf) continue;
+      k = root->keys[std::uniform_int_distribution<int>(0, root->n - 1)(rng)];
+      if (!map.erase(k) || !reference.erase(k))
+        throw std::runtime_error("Wrong map erase of separator " +
+                                 std::to_string(k));
+    } else {
+      const std::string* value = map.find(k);
+      const std::map<int, std::string>::const_iterator it = reference.find(k);
+      if ((value == nullptr) != (it == reference.end()) ||
+          (value && *value != it->second))
+        throw std::runtime_error("Wrong map find of " + std::to_string(k));
+    }
+
+    if (i % 1000 == 0 || i == n_ops) compare_map<t>(map, reference);
+  }
+
+  // moved maps take the entries along and leave an empty, usable map
+  b::map<int, std::string, t> moved(std::move(map));
+  compare_map<t>(moved, reference);
+  compare_map<t>(map, std::map<int, std::string>());
+  map.insert(-1, "moved from");
+  compare_map<t>(map, std::map<int, std::string>{{-1, "moved from"}});
+  map = std::move(moved);
+  compare_map<t>(map, reference);
+
+  map.clear();
+  compare_map<t>(map, std::map<int, std::string>());
+  for (int i = 0; i < 10 * t; i++) map[i] = std::to_string(i);
+  for (int i = 0; i < 10 * t; i++)
+    if (!map.find(i) || *map.find(i) != std::to_string(i))
+      throw std::runtime_error("Wrong map find after clear");
+}
+
+template <int t>
+void check_fixed_degree(const int n_ops, std::mt19937& rng) {
+  check_fixed_tree<t>(n_ops, rng);
+  check_map<t>(n_ops, rng);
+}
+
+bool check_fixed(const int t, const int n_ops, std::mt19937& rng) {
+  /* runs the checks of fixed_tree and b::map for 't' if they are
+  instantiated for it.
+  - returns: whether they were */
+
+  switch (t) {
+    case 2:
+      check_fixed_degree<2>(n_ops, rng);
+      return true;
+    case 4:
+      check_fixed_degree<4>(n_ops, rng);
+      return true;
+    case 8:
+      check_fixed_degree<8>(n_ops, rng);
+      return true;
+    case 16:
+      check_fixed_degree<16>(n_ops, rng);
+      return true;
+    case 32:
+      check_fixed_degree<32>(n_ops, rng);
+      return true;
+    case 64:
+      check_fixed_degree<64>(n_ops, rng);
+      return true;
+    case 128:
+      check_fixed_degree<128>(n_ops, rng);
+      return true;
+  }
+  return false;
+}
+
+void check_paged(const int n_ops, std::mt19937& rng) {
+  /* runs 'n_ops' random operations on a paged_tree of small pages cached in
+  few frames and a std::set, comparing both along the way and reopening the
+  tree's file every tenth of the operations. */
+
+  typedef b::paged_tree<int, 128> tree_type;
+  const char* file_name = "tree_bench.pages";
+  std::remove(file_name);
+  std::unique_ptr<tree_type> tree(new tree_type(file_name, 16));
+  std::set<int> reference;
+  std::uniform_int_distribution<int> key(0, n_ops / 4), op(0, 9);
+  for (int i = 1; i <= n_ops; i++) {
+    const int k = key(rng);
+    const int o = op(rng);
+    if (o < 4) {
+      if (reference.insert(k).second) tree->insert(k);
+    } else if (o < 7) {
+      tree->erase(k);
+      reference.erase(k);
+    } else if (tree->search(k) != (reference.count(k) > 0))
+      throw std::runtime_error("Wrong paged search of " + std::to_string(k));
+
+    if (i % std::max(1, n_ops / 10) == 0 || i == n_ops) {
+      // a reopened tree must read back what the closed one wrote
+      tree.reset();
+      tree.reset(new tree_type(file_name, 16));
+      std::vector<int> keys;
+      tree->collect(keys);
+      if (keys.size() != reference.size() ||
+          !std::equal(keys.begin(), keys.end(), reference.begin()))
+        throw std::runtime_error("Paged keys differ from reference");
+    }
+  }
+  tree.reset();
+
+  // empty, short or foreign files must be refused rather than read
+  for (const std::string& contents :
+       {std::string(), std::string("BTPG"), std::string(64, 'x')}) {
+    {
+      std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+      file << contents;
+    }
+    bool refused = false;
+    try {
+      tree_type bad(file_name, 16);
+    } catch (const std::runtime_error&) {
+      refused = true;
+    }
+    if (!refused) throw std::runtime_error("Opened a file with a bad header");
+  }
+  std::remove(file_name);
+}
+
+void check_concurrent(const int n_threads, const int n_ops) {
+  /* splits 'n_ops' random operations among 'n_threads' threads sharing a
+  concurrent_tree. Each thread updates its own keys, those congruent to its
+  number, and checks them against its own std::multiset, while also
+  searching the keys of the others. Once every thread is done, the tree is
+  compared with all the multisets and must free every node it retired. */
+
+  b::concurrent_tree<int, 4> tree;
+  std::vector<std::multiset<int>> references(n_threads);
+  std::vector<std::string> errors(n_threads);
+  std::vector<std::thread> workers;
+  for (int id = 0; id < n_threads; id++)
+    workers.emplace_back([&, id]() {
+      std::mt19937 rng(id);
+      std::multiset<int>& reference = references[id];
+      std::uniform_int_distribution<int> key(0, n_ops / 4 / n_threads),
+          op(0, 9);
+      for (int i = 0; i < n_ops / n_threads; i++) {
+        const int k = key(rng) * n_threads + id;
+        const int o = op(rng);
+        if (o < 4) {
+          tree.insert(k);
+          reference.insert(k);
+        } else if (o < 7) {
+          std::multiset<int>::iterator it = reference.find(k);
+          if (tree.erase(k) != (it != reference.end())) {
+            errors[id] = "Wrong concurrent erase of " + std::to_string(k);
+            return;
+          }
+          if (it != reference.end()) reference.erase(it);
+        } else if (o < 9) {
+          if (tree.search(k) != (reference.count(k) > 0)) {
+            errors[id] = "Wrong concurrent search of " + std::to_string(k);
+            return;
+          }
+        } else
+          tree.search(k + 1);
+
+        // vary interleavings even on few cores
+        if (rng() % 8 == 0) std::this_thread::yield();
+      }
+    });
+  for (std::thread& worker : workers) worker.join();
+  for (const std::string& error : errors)
+    if (!error.empty()) throw std::runtime_error(error);
+
+  std::vector<int> keys, expected;
+  tree.collect(keys);
+  for (const std::multiset<int>& reference : references)
+    expected.insert(expected.end(), reference.begin(), reference.end());
+  std::sort(expected.begin(), expected.end());
+  if (keys != expected)
+    throw std::runtime_error("Concurrent keys differ from references");
+  if (tree.reclaim())
+    throw std::runtime_error("Retired nodes left once quiescent");
+}
+
+// searches add up their hits here so they are not optimized away
+volatile int sink;
+
+struct result {
+  double insert, search, mixed, erase;
+  double bytes_per_key;
+};
+
+template <typename Insert, typename Search, typename Erase, typename Inspect>
+result measure(const std::vector<int>& keys, const std::vector<int>& lookups,
+               std::mt19937& rng, Insert insert, Search search, Erase erase,
+               Inspect inspect) {
+  /* times inserting 'keys', searching 'lookups', a mix of half searches and
+  a quarter each of inserts and erases, and erasing every key. 'inspect' is
+  called untimed once every key is inserted.
+  - returns: throughputs in millions of operations per second and heap
+  bytes in use per key after the inserts */
+
+  result ret;
+  const double n = keys.size();
+  const std::size_t heap = heap_in_use();
+  timer::time_point start = timer::now();
+  for (const int key : keys) insert(key);
+  ret.insert = n / seconds_since(start) / 1e6;
+  ret.bytes_per_key = (heap_in_use() - heap) / n;
+  inspect();
+
+  start = timer::now();
+  int found = 0;
+  for (const int key : lookups) found += search(key);
+  ret.search = lookups.size() / seconds_since(start) / 1e6;
+
+  // mixed operations keep the size about constant
+  std::uniform_int_distribution<int> op(0, 3);
+  std::vector<int> ops(lookups.size());
+  for (int& o : ops) o = op(rng);
+  start = timer::now();
+  for (int i = 0; i < (int)lookups.size(); i++) {
+    if (ops[i] == 0)
+      insert(lookups[i]);
+    else if (ops[i] == 1)
+      erase(lookups[i]);
+    else
+      found += search(lookups[i]);
+  }
+  ret.mixed = lookups.size() / seconds_since(start) / 1e6;
+
+  start = timer::now();
+  for (const int key : keys) erase(key);
+  ret.erase = n / seconds_since(start) / 1e6;
+
+  sink = found;
+  return ret;
+}
+
+template <int t>
+result measure_fixed_tree(const std::vector<int>& keys,
+                          const std::vector<int>& lookups, std::mt19937& rng) {
+  b::fixed_tree<int, t> tree;
+  return measure(
+      keys, lookups, rng, [&](const int key) { tree.insert(key); },
+      [&](const int key) { return tree.search(key); },
+      [&](const int key) { tree.erase(key); }, []() {});
+}
+
+bool measure_fixed(const int t, const std::vector<int>& keys,
+                   const std::vector<int>& lookups, std::mt19937& rng,
+                   result& r) {
+  /* times a fixed_tree of minimum degree 't' if it is instantiated for it.
+  - returns: whether it was */
+
+  switch (t) {
+    case 2:
+      r = measure_fixed_tree<2>(keys, lookups, rng);
+      return true;
+    case 4:
+      r = measure_fixed_tree<4>(keys, lookups, rng);
+      return true;
+    case 8:
+      r = measure_fixed_tree<8>(keys, lookups, rng);
+      return true;
+    case 16:
+      r = measure_fixed_tree<16>(keys, lookups, rng);
+      return true;
+    case 32:
+      r = measure_fixed_tree<32>(keys, lookups, rng);
+      return true;
+    case 64:
+      r = measure_fixed_tree<64>(keys, lookups, rng);
+      return true;
+    case 128:
+      r = measure_fixed_tree<128>(keys, lookups, rng);
+      return true;
+  }
+  return false;
+}
+
+void report(const std::string& name, const result& r) {
+  std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(9) << r.insert << std::setw(9)
+            << r.search << std::setw(9) << r.mixed << std::setw(9) << r.erase
+            << std::setw(9) << std::setprecision(1) << r.bytes_per_key;
+}
+
+void bench(const std::string& order, const int n, const std::vector<int>& ts) {
+  std::mt19937 rng(42);
+  const std::vector<int> keys = make_keys(order, n, rng);
+  std::vector<int> lookups =
+      (order == "zipfian" ? make_keys(order, n, rng) : keys);
+  if (order != "zipfian") std::shuffle(lookups.begin(), lookups.end(), rng);
+
+  std::cout << std::endl
+            << order << " keys, " << n << " of each operation" << std::endl
+            << std::left << std::setw(12) << "container" << std::right
+            << std::setw(9) << "insert" << std::setw(9) << "search"
+            << std::setw(9) << "mixed" << std::setw(9) << "erase"
+            << std::setw(9) << "B/key" << std::setw(8) << "height"
+            << std::setw(8) << "fill %" << std::endl;
+
+  for (const int t : ts) {
+    b::tree<int> tree(t);
+    shape s;
+    const result r = measure(
+        keys, lookups, rng, [&](const int key) { tree.insert(key); },
+        [&](const int key) { return tree.search(key); },
+        [&](const int key) { tree.erase(key); },
+        [&]() { s = validate(tree.get_root(), nullptr, nullptr, t, true); });
+    report("b::tree " + std::to_string(t), r);
+    std::cout << std::setw(8) << s.height + 1 << std::setw(8)
+              << 100.0 * s.keys / (s.nodes * (2.0 * t - 1)) << std::endl;
+  }
+
+  // same degrees with keys and children inline in cache-aligned nodes
+  for (const int t : ts) {
+    result r;
+    if (!measure_fixed(t, keys, lookups, rng, r)) continue;
+    report("fixed " + std::to_string(t), r);
+    std::cout << std::setw(8) << "-" << std::setw(8) << "-" << std::endl;
+  }
+
+  std::multiset<int> set;
+  const result r = measure(
+      keys, lookups, rng, [&](const int key) { set.insert(key); },
+      [&](const int key) { return set.find(key) != set.end(); },
+      [&](const int key) {
+        std::multiset<int>::iterator it = set.find(key);
+        if (it != set.end()) set.erase(it);
+      },
+      []() {});
+  report("std::set", r);
+  std::cout << std::setw(8) << "-" << std::setw(8) << "-" << std::endl;
+}
+
+template <typename Run>
+double measure_threads(const std::vector<std::vector<int>>& keys,
+                       const std::vector<std::vector<int>>& ops, Run run) {
+  /* times one thread per entry of 'keys', each running 'run' on its
+  operations 'ops' and keys, all started together once every thread is up.
+  - returns: throughput of all threads in millions of operations per second */
+
+  const int n_threads = keys.size();
+  std::atomic<int> ready(0), found(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  for (int id = 0; id < n_threads; id++)
+    workers.emplace_back([&, id]() {
+      ready++;
+      while (!go) std::this_thread::yield();
+      int hits = 0;
+      for (std::size_t i = 0; i < keys[id].size(); i++)
+        hits += run(ops[id][i], keys[id][i]);
+      found += hits;
+    });
+
+  while (ready < n_threads) std::this_thread::yield();
+  const timer::time_point start = timer::now();
+  go = true;
+  for (std::thread& worker : workers) worker.join();
+  const double elapsed = seconds_since(start);
+
+  long long n_ops = 0;
+  for (const std::vector<int>& k : keys) n_ops += k.size();
+  sink = found;
+  return n_ops / elapsed / 1e6;
+}
+
+void bench_threads(const int n, const std::vector<int>& thread_counts) {
+  /* times 'n' operations mixing searches with as many inserts as erases,
+  keeping the size about constant, split among each of 'thread_counts'
+  threads sharing a concurrent_tree or a b::tree behind a single mutex.
+  Both start with 'n' random keys and have minimum degree 16. */
+
+  std::mt19937 rng(42);
+  const std::vector<int> keys = make_keys("random", n, rng);
+  std::uniform_int_distribution<int> key(0, 2 * n - 1), percent(0, 99);
+
+  std::cout << std::endl
+            << "threads sharing a tree of " << n << " random keys, " << n
+            << " operations" << std::endl
+            << std::left << std::setw(12) << "search %" << std::right
+            << std::setw(9) << "threads" << std::setw(12) << "concurrent"
+            << std::setw(9) << "locked" << std::setw(9) << "speedup"
+            << std::endl;
+
+  for (const int reads : {90, 50}) {
+    double single = 0;
+    for (const int n_threads : thread_counts) {
+      // 0 searches, 1 inserts and 2 erases
+      std::vector<std::vector<int>> ops(n_threads), lookups(n_threads);
+      for (int i = 0; i < n; i++) {
+        const int p = percent(rng);
+        ops[i % n_threads].push_back(p < reads ? 0 : 1 + p % 2);
+        lookups[i % n_threads].push_back(key(rng));
+      }
+
+      b::concurrent_tree<int, 16> concurrent;
+      for (const int k : keys) concurrent.insert(k);
+      const double c =
+          measure_threads(lookups, ops, [&](const int op, const int k) {
+            if (op == 1) concurrent.insert(k);
+            if (op == 2) return concurrent.erase(k);
+            return op == 0 && concurrent.search(k);
+          });
+
+      b::tree<int> tree(16);
+      std::mutex lock;
+      for (const int k : keys) tree.insert(k);
+      const double l =
+          measure_threads(lookups, ops, [&](const int op, const int k) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (op == 1) tree.insert(k);
+            if (op == 2) tree.erase(k);
+            return op == 0 && tree.search(k);
+          });
+
+      if (!single) single = c;
+      std::cout << std::left << std::setw(12) << reads << std::right
+                << std::setw(9) << n_threads << std::fixed
+                << std::setprecision(2) << std::setw(12) << c << std::setw(9)
+                << l << std::setw(9) << c / single << std::endl;
+    }
+  }
+}
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " n_keys [t ...]" << std::endl
+              << "       " << argv[0] << " -c n_ops [t ...]" << std::endl
+              << "       " << argv[0] << " -p n_ops [threads ...]" << std::endl
+              << "       " << argv[0] << " -s n_ops [threads ...]"
+              << std::endl;
+    return 1;
+  }
+
+  const bool checking = !std::strcmp(argv[1], "-c");
+  const bool threaded = !std::strcmp(argv[1], "-p");
+  const bool scaling = !std::strcmp(argv[1], "-s");
+  const int first = (checking || threaded || scaling ? 2 : 1);
+  if (argc <= first) {
+    std::cerr << "missing "
+              << (checking || threaded || scaling ? "n_ops" : "n_keys")
+              << std::endl;
+    return 1;
+  }
+  const int n = std::atoi(argv[first]);
+
+  std::vector<int> ts;
+  for (int i = first + 1; i < argc; i++) ts.push_back(std::atoi(argv[i]));
+  if (ts.empty()) ts = {2, 4, 8, 16, 32, 64, 128};
+
+  if (threaded) {
+    // ts are thread counts here
+    if (argc <= first + 1) ts = {1, 4, 8};
+    for (const int n_threads : ts) {
+      try {
+        check_concurrent(n_threads, n);
+      } catch (const std::runtime_error& e) {
+        std::cerr << n_threads << " threads: " << e.what() << std::endl;
+        return 1;
+      }
+      std::cout << n_threads << " threads: " << n << " operations ok"
+                << std::endl;
+    }
+    return 0;
+  }
+
+  if (scaling) {
+    // ts are thread counts here too
+    if (argc <= first + 1) ts = {1, 2, 4, 8};
+    std::cout << "throughput in millions of operations per second, speedup "
+                 "over the first thread count"
+              << std::endl;
+    bench_threads(n, ts);
+    return 0;
+  }
+
+  if (checking) {
+    std::mt19937 rng(1);
+    for (const int t : ts) {
+      try {
+        check(t, n, rng);
+        check_ranges(t, n, rng);
+        check_snapshots(t, n, rng);
+        check_bplus(t, n, rng);
+        check_fixed(t, n, rng);
+      } catch (const std::runtime_error& e) {
+        std::cerr << "t = " << t << ": " << e.what() << std::endl;
+        return 1;
+      }
+      std::cout << "t = " << t << ": " << n << " operations ok" << std::endl;
+    }
+
+    try {
+      check_paged(n, rng);
+    } catch (const std::runtime_error& e) {
+      std::cerr << "paged_tree: " << e.what() << std::endl;
+      return 1;
+    }
+    std::cout << "paged_tree: " << n << " operations ok" << std::endl;
+    return 0;
+  }
+
+  std::cout << "throughput in millions of operations per second" << std::endl;
+  for (const std::string order : {"random", "sorted", "reverse", "zipfian"})
+    bench(order, n, ts);
+}
@@ -0,0 +1,71 @@
+#ifndef FRAME_READER_HPP
+#define FRAME_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// reader of length-prefixed frames from a file descriptor: each frame is a
+// 32-bit length, in the machine's byte order, followed by that many bytes
+// input is read a large chunk at a time and frames are handed out as views
+// into the chunk, valid until it is filled again
+class FrameReader {
+ private:
+  const int fd;
+  std::vector<char> buffer;
+  std::size_t begin, end;
+
+ public:
+  struct Frame {
+    const char *data;
+    std::size_t size;
+  };
+
+  FrameReader(const int, const std::size_t = 1 << 20);
+
+  bool next(Frame &);
+  bool fill();
+};
+
+template <typename RunFrame>
+void run_frames(RunFrame run_frame) {
+  /* runs commands framed by length from standard input, writing the output
+  of each framed likewise. Output of every command in a chunk of input is
+  gathered and written at once, rather than flushed line by line. Commands
+  that fail are reported and input goes on.
+  - 'run_frame': function running the command in a frame, writing its output
+  to a stream and returning 'false' if it ends input */
+
+  FrameReader reader(0);
+  std::ostringstream batch;
+  bool running = true;
+  while (running && reader.fill()) {
+    FrameReader::Frame frame;
+    while (running && reader.next(frame)) {
+      // reserve the length and fill it in once the output is known
+      const std::streampos start = batch.tellp();
+      std::uint32_t size = 0;
+      batch.write(reinterpret_cast<const char *>(&size), sizeof size);
+      try {
+        running = run_frame(frame, batch);
+      } catch (const std::runtime_error &e) {
+        std::cerr << e.what() << std::endl;
+      }
+      const std::streampos end = batch.tellp();
+      size = end - start - sizeof size;
+      batch.seekp(start);
+      batch.write(reinterpret_cast<const char *>(&size), sizeof size);
+      batch.seekp(end);
+    }
+
+    const std::string output = batch.str();
+    std::cout.write(output.data(), output.size()).flush();
+    batch.str("");
+  }
+}
+
+#endif
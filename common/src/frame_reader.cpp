@@ -0,0 +1,53 @@
+#include "frame_reader.hpp"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+FrameReader::FrameReader(const int fd, const std::size_t chunk_size)
+    : fd(fd), buffer(chunk_size), begin(0), end(0) {}
+
+bool FrameReader::next(Frame &frame) {
+  /* takes the next frame out of the chunk read.
+  - 'frame': view to point at the frame's bytes
+  - returns: 'false' if the chunk holds no complete frame */
+
+  std::uint32_t size;
+  if (end - begin < sizeof size) return false;
+  std::memcpy(&size, buffer.data() + begin, sizeof size);
+  if (end - begin - sizeof size < size) return false;
+
+  frame.data = buffer.data() + begin + sizeof size;
+  frame.size = size;
+  begin += sizeof size + size;
+  return true;
+}
+
+bool FrameReader::fill() {
+  /* reads the next chunk of input after the incomplete frame left, if any,
+  growing the buffer if that frame does not fit it.
+  - returns: 'false' at the end of input */
+
+  std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+  end -= begin;
+  begin = 0;
+
+  std::uint32_t size;
+  if (end >= sizeof size) {
+    std::memcpy(&size, buffer.data(), sizeof size);
+    if (sizeof size + size > buffer.size()) buffer.resize(sizeof size + size);
+  }
+
+  ssize_t got;
+  do
+    got = read(fd, buffer.data() + end, buffer.size() - end);
+  while (got < 0 && errno == EINTR);
+  if (got < 0) throw std::runtime_error("Unable to read input");
+  if (!got && end) throw std::runtime_error("Input ends within a frame");
+
+  end += got;
+  return got > 0;
+}
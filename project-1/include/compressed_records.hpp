@@ -0,0 +1,67 @@
+#ifndef COMPRESSED_RECORDS_HPP
+#define COMPRESSED_RECORDS_HPP
+
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "file.hpp"
+#include "huffman.hpp"
+
+// read-only image of a File with its records packed, dropping the unused
+// bytes of names and empty positions, and Huffman coded a page at a time
+// with a code trained on the whole file
+// recently decoded pages are kept in memory, least recently used evicted
+// File removes the image as soon as it writes a record, so it is never stale
+class CompressedRecords {
+ public:
+  static const unsigned int PAGE_RECORDS = 256;
+  static const unsigned int CACHED_PAGES = 64;
+
+  CompressedRecords(const std::string &, const unsigned int);
+  CompressedRecords(const CompressedRecords &) = delete;
+  CompressedRecords &operator=(const CompressedRecords &) = delete;
+
+  Record read(const unsigned int);
+  void read_page(const unsigned int, std::ifstream &,
+                 std::vector<Record> &) const;
+
+  static void write(const std::string &, const unsigned int,
+                    const std::function<Record(const unsigned int)> &,
+                    std::ostream &);
+
+ private:
+  struct header {
+    char magic[4];
+    unsigned int file_size, n_pages;
+    unsigned char lengths[Huffman::N_SYMBOLS];
+  };
+
+  // where each page's codes lie and how many bytes they decode to
+  struct page_entry {
+    unsigned long long offset;
+    unsigned int compressed_size, packed_size;
+  };
+
+  const std::string file_name;
+  const unsigned int file_size;
+  std::ifstream handle;
+  std::unique_ptr<Huffman> code;
+  std::vector<page_entry> pages;
+
+  std::list<std::pair<unsigned int, std::vector<Record>>> cache;
+  std::unordered_map<unsigned int,
+                     std::list<std::pair<unsigned int, std::vector<Record>>>::
+                         iterator>
+      cached;
+
+  static void pack(const Record &, std::string &);
+  static Record unpack(const char *&);
+};
+
+#endif
@@ -0,0 +1,357 @@
+#ifndef EXTERNAL_SORT_HPP
+#define EXTERNAL_SORT_HPP
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// reader of the fixed-size elements between byte offsets 'begin' and 'end'
+// of a file, a block at a time
+template <typename T>
+class BlockReader {
+ private:
+  int fd;
+  off_t offset, end;
+  std::vector<T> buffer;
+  std::size_t pos;
+
+  bool fill() {
+    /* reads next block into buffer.
+    - returns: 'false' if there was nothing left to read */
+
+    const std::size_t n = std::min<off_t>(buffer.capacity(),
+                                          (end - offset) / sizeof(T));
+    buffer.resize(n);
+    char *data = reinterpret_cast<char *>(buffer.data());
+    for (std::size_t done = 0; done < n * sizeof(T);) {
+      const ssize_t got = pread(fd, data + done, n * sizeof(T) - done, offset);
+      if (got < 0 && errno == EINTR) continue;
+      if (got <= 0) throw std::runtime_error("Unable to read block");
+      done += got;
+      offset += got;
+    }
+    pos = 0;
+    return n > 0;
+  }
+
+ public:
+  BlockReader(const std::string &file_name, const std::size_t block_size,
+              const off_t begin = 0, const off_t end = -1)
+      : offset(begin), end(end), pos(0) {
+    fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Unable to open file " + file_name);
+    if (end < 0) {
+      struct stat st;
+      if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw std::runtime_error("Unable to open file " + file_name);
+      }
+      this->end = st.st_size;
+    }
+    posix_fadvise(fd, begin, this->end - begin, POSIX_FADV_SEQUENTIAL);
+    buffer.reserve(block_size);
+  }
+
+  ~BlockReader() { close(fd); }
+  BlockReader(const BlockReader &) = delete;
+  BlockReader &operator=(const BlockReader &) = delete;
+
+  const T *peek() {
+    /* returns: pointer to next element, or nullptr once every element has
+    been read */
+
+    if (pos == buffer.size() && !fill()) return nullptr;
+    return &buffer[pos];
+  }
+
+  void pop() { pos++; }
+};
+
+// writer of fixed-size elements to a new file, a block at a time
+template <typename T>
+class BlockWriter {
+ private:
+  int fd;
+  std::vector<T> buffer;
+
+ public:
+  BlockWriter(const std::string &file_name, const std::size_t block_size) {
+    fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Unable to create file " + file_name);
+    buffer.reserve(block_size);
+  }
+
+  ~BlockWriter() {
+    if (fd >= 0) ::close(fd);
+  }
+  BlockWriter(const BlockWriter &) = delete;
+  BlockWriter &operator=(const BlockWriter &) = delete;
+
+  void push(const T &x) {
+    buffer.push_back(x);
+    if (buffer.size() == buffer.capacity()) flush();
+  }
+
+  void flush() {
+    const char *data = reinterpret_cast<const char *>(buffer.data());
+    for (std::size_t done = 0; done < buffer.size() * sizeof(T);) {
+      const ssize_t put = write(fd, data + done, buffer.size() * sizeof(T) - done);
+      if (put < 0 && errno == EINTR) continue;
+      if (put <= 0) throw std::runtime_error("Unable to write block");
+      done += put;
+    }
+    buffer.clear();
+  }
+
+  void close() {
+    flush();
+    ::close(fd);
+    fd = -1;
+  }
+};
+
+// tournament over k readers where each internal node keeps the loser of
+// the match played there, so replacing the winner replays a single path of
+// log k matches against the losers on it
+template <typename T, typename Less>
+class LoserTree {
+ private:
+  std::vector<BlockReader<T> *> sources;
+  std::vector<std::size_t> losers;
+  std::size_t winner;
+  Less less;
+
+  bool beats(const std::size_t a, const std::size_t b) {
+    // exhausted readers lose every match, ties go to the earlier reader
+    const T *x = sources[a]->peek();
+    const T *y = sources[b]->peek();
+    if (!x || !y) return x;
+    return less(*x, *y) || (!less(*y, *x) && a < b);
+  }
+
+ public:
+  LoserTree(const std::vector<BlockReader<T> *> &sources, const Less &less)
+      : sources(sources), losers(sources.size()), winner(0), less(less) {
+    // play every match bottom-up, leaf i being node k + i
+    const std::size_t k = sources.size();
+    std::vector<std::size_t> winners(2 * k);
+    for (std::size_t i = 0; i < k; i++) winners[k + i] = i;
+    for (std::size_t node = k - 1; node >= 1; node--) {
+      const std::size_t a = winners[2 * node], b = winners[2 * node + 1];
+      winners[node] = (beats(a, b) ? a : b);
+      losers[node] = (beats(a, b) ? b : a);
+    }
+    if (k > 1) winner = winners[1];
+  }
+
+  const T *top() { return sources[winner]->peek(); }
+
+  void pop() {
+    sources[winner]->pop();
+    for (std::size_t node = (winner + sources.size()) / 2; node >= 1;
+         node /= 2)
+      if (beats(losers[node], winner)) std::swap(losers[node], winner);
+  }
+};
+
+// sorts files of fixed-size elements larger than memory: replacement
+// selection writes runs of about twice the memory, which are merged a
+// bounded number at a time until one is left
+template <typename T, typename Less = std::less<T>>
+class ExternalSort {
+ private:
+  static const std::size_t BLOCK_BYTES = 1 << 20;
+
+  const std::size_t memory;
+  const unsigned int threads;
+  const Less less;
+
+  // elements per block read or written
+  std::size_t block_size;
+
+  std::string run_prefix;
+  std::atomic<unsigned int> next_run;
+  unsigned int n_runs, n_merges;
+
+  struct Entry {
+    unsigned int run;
+    T value;
+  };
+
+  std::string new_run() {
+    return run_prefix + std::to_string(next_run++);
+  }
+
+  void generate_runs(const std::string &input, const off_t begin,
+                     const off_t end, const std::size_t capacity,
+                     std::vector<std::string> &runs) {
+    /* writes the elements between offsets 'begin' and 'end' of 'input' to
+    sorted runs, holding at most 'capacity' elements in memory.
+    - 'runs': vector to append names of runs to */
+
+    BlockReader<T> reader(input, block_size, begin, end);
+
+    // entries of a later run sink below every entry of the current one
+    const Less &less = this->less;
+    const auto later = [&less](const Entry &a, const Entry &b) {
+      return a.run != b.run ? a.run > b.run : less(b.value, a.value);
+    };
+
+    std::vector<Entry> heap;
+    heap.reserve(std::min<off_t>(capacity, (end - begin) / sizeof(T)));
+    for (const T *x; heap.size() < capacity && (x = reader.peek()); reader.pop())
+      heap.push_back(Entry{0, *x});
+    std::make_heap(heap.begin(), heap.end(), later);
+    if (heap.empty()) return;
+
+    unsigned int run = 0;
+    runs.push_back(new_run());
+    std::unique_ptr<BlockWriter<T>> writer(
+        new BlockWriter<T>(runs.back(), block_size));
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), later);
+      Entry &smallest = heap.back();
+      if (smallest.run != run) {
+        writer->close();
+        run = smallest.run;
+        runs.push_back(new_run());
+        writer.reset(new BlockWriter<T>(runs.back(), block_size));
+      }
+      writer->push(smallest.value);
+
+      // an element smaller than the one just written waits for the next run
+      if (const T *x = reader.peek()) {
+        smallest.run = run + less(*x, smallest.value);
+        smallest.value = *x;
+        reader.pop();
+        std::push_heap(heap.begin(), heap.end(), later);
+      } else
+        heap.pop_back();
+    }
+    writer->close();
+  }
+
+  void merge(const std::vector<std::string> &inputs,
+             const std::string &output) {
+    /* merges sorted files 'inputs' into 'output', removing them. */
+
+    std::vector<std::unique_ptr<BlockReader<T>>> readers;
+    std::vector<BlockReader<T> *> sources;
+    for (const std::string &input : inputs) {
+      readers.emplace_back(new BlockReader<T>(input, block_size));
+      sources.push_back(readers.back().get());
+    }
+
+    LoserTree<T, Less> tree(sources, less);
+    BlockWriter<T> writer(output, block_size);
+    for (const T *x; (x = tree.top()); tree.pop()) writer.push(*x);
+    writer.close();
+
+    for (const std::string &input : inputs) std::remove(input.c_str());
+  }
+
+ public:
+  ExternalSort(const std::size_t memory, const unsigned int threads = 1,
+               const Less &less = Less())
+      : memory(memory),
+        threads(std::max(1u, threads)),
+        less(less),
+        next_run(0),
+        n_runs(0),
+        n_merges(0) {
+    const std::size_t block_bytes =
+        (memory / 16 < BLOCK_BYTES ? memory / 16 : BLOCK_BYTES);
+    block_size = std::max<std::size_t>(1, block_bytes / sizeof(T));
+  }
+
+  void sort(const std::string &input, const std::string &output) {
+    /* writes the elements of file 'input' to file 'output' in order, using
+    about 'memory' bytes besides temporary runs next to 'output'. */
+
+    struct stat st;
+    if (stat(input.c_str(), &st) < 0)
+      throw std::runtime_error("Unable to open file " + input);
+    if (st.st_size % sizeof(T))
+      throw std::runtime_error("Unexpected size of file " + input + ". Got " +
+                               std::to_string(st.st_size) +
+                               " bytes, not a multiple of " +
+                               std::to_string(sizeof(T)));
+    const off_t n = st.st_size / sizeof(T);
+    run_prefix = output + ".run";
+    next_run = 0;
+
+    // each thread replaces selection over its own slice, with its share of
+    // memory less its input and output blocks
+    const std::size_t share = memory / threads;
+    const std::size_t capacity = std::max<std::size_t>(
+        1, (share > 2 * block_size * sizeof(T)
+                ? share - 2 * block_size * sizeof(T)
+                : 0) / sizeof(Entry));
+    std::vector<std::vector<std::string>> slices(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threads; i++)
+      workers.emplace_back([&, i]() {
+        try {
+          generate_runs(input, n * i / threads * sizeof(T),
+                        n * (i + 1) / threads * sizeof(T), capacity, slices[i]);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    for (std::thread &worker : workers) worker.join();
+
+    std::vector<std::string> runs;
+    for (const std::vector<std::string> &slice : slices)
+      runs.insert(runs.end(), slice.begin(), slice.end());
+    for (const std::exception_ptr &error : errors)
+      if (error) {
+        for (const std::string &run : runs) std::remove(run.c_str());
+        std::rethrow_exception(error);
+      }
+    n_runs = runs.size();
+    n_merges = 0;
+
+    // a single run is the output already
+    if (runs.empty()) {
+      BlockWriter<T>(output, block_size).close();
+      return;
+    }
+    if (runs.size() == 1 && !std::rename(runs[0].c_str(), output.c_str()))
+      return;
+
+    // merge as many runs as there are blocks left after the output's,
+    // oldest first, until the last merge can write the output
+    const std::size_t fan_in = std::max<std::size_t>(
+        2, memory / (block_size * sizeof(T)) - 1);
+    std::size_t first = 0;
+    while (runs.size() - first > fan_in) {
+      const std::vector<std::string> group(runs.begin() + first,
+                                           runs.begin() + first + fan_in);
+      runs.push_back(new_run());
+      merge(group, runs.back());
+      first += fan_in;
+      n_merges++;
+    }
+    merge(std::vector<std::string>(runs.begin() + first, runs.end()), output);
+    n_merges++;
+  }
+
+  unsigned int runs() const { return n_runs; }
+
+  unsigned int merges() const { return n_merges; }
+};
+
+#endif
@@ -2,7 +2,12 @@
 #define FILE_HPP
 
 #include <fstream>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
+
+class CompressedRecords;
 
 struct Record {
   bool good;
@@ -21,17 +26,48 @@ class File {
   std::fstream handle;
   int empty_list_head;
 
+  // if set, records are read from a compressed image instead of handle
+  std::unique_ptr<CompressedRecords> compressed;
+
+  // unset once a compressed image of the file left over may be stale
+  bool image_current;
+
   bool already_exists() const;
   void create();
   void open();
   void read_header();
+  void discard_image();
   unsigned int hash(const unsigned int);
   void write(const Record &, const unsigned int);
   void empty_list_delete(const Record &);
   int search(const unsigned int);
+  static void print_entry(const unsigned int, const Record &, std::ostream &);
+
+  // reader of records through a stream of its own, so threads can read the
+  // file at the same time, a block at a time or at random
+  class Reader {
+   private:
+    const File &f;
+    std::ifstream in;
+    std::vector<Record> blocks, records;
+
+    // compressed page held in records, if any
+    int page;
+
+   public:
+    Reader(const File &);
+    const Record *block(const unsigned int, const unsigned int);
+    Record read(const unsigned int);
+  };
+
+  typedef std::function<void(Reader &, const unsigned int, const Record *,
+                             const unsigned int, std::ostream &)>
+      block_visitor;
+  void scan_blocks(const unsigned int, const block_visitor &, std::ostream &);
 
  public:
-  File(const unsigned int, const std::string &file_name = "records.log");
+  File(const unsigned int, const std::string &file_name = "records.log",
+       const bool compressed = false);
   ~File();
   File(const File &) = delete;
   File(File &&) = delete;
@@ -41,8 +77,10 @@ class File {
   void insert(Record &, std::ostream &);
   void lookup(const unsigned int, std::ostream &);
   void remove(const unsigned int, std::ostream &);
-  void print(std::ostream &);
-  void stats(std::ostream &);
+  void print(std::ostream &, const unsigned int = 1);
+  void scan(const std::string &, std::ostream &, const unsigned int = 1);
+  void stats(std::ostream &, const unsigned int = 1);
+  void compress(std::ostream &);
 };
 
 #endif
@@ -0,0 +1,36 @@
+#ifndef HUFFMAN_HPP
+#define HUFFMAN_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// canonical Huffman code over bytes, with codes at most MAX_LENGTH bits long
+// so they are decoded by looking up the next MAX_LENGTH bits in one table
+class Huffman {
+ public:
+  static const unsigned int MAX_LENGTH = 12;
+  static const unsigned int N_SYMBOLS = 256;
+
+  Huffman(const std::vector<unsigned long long> &);
+  Huffman(const unsigned char *);
+
+  const unsigned char *lengths() const { return length; }
+
+  void encode(const std::string &, std::string &) const;
+  void decode(const char *, const std::size_t, char *, const std::size_t) const;
+
+ private:
+  struct entry {
+    unsigned char symbol, length;
+  };
+
+  unsigned char length[N_SYMBOLS];
+  unsigned int code[N_SYMBOLS];
+  entry table[1 << MAX_LENGTH];
+
+  void limit_lengths(const std::vector<unsigned long long> &);
+  void assign_codes();
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef PATTERN_HPP
+#define PATTERN_HPP
+
+#include <string>
+#include <vector>
+
+// substring search by Boyer-Moore: the pattern is compared right to left
+// and, on a mismatch, slides by the larger of the bad character shift
+// (delta_1) and the good suffix shift (delta_2)
+class Pattern {
+ private:
+  // patterns up to this long are first looked for by comparing their first
+  // and last characters against 16 text positions at once
+  static const unsigned int SHORT_LENGTH = 8;
+
+  const std::string pattern;
+  int delta_1[256];
+  std::vector<int> delta_2;
+
+  int rightmost_plausible_reoccurrence(const int);
+
+ public:
+  Pattern(const std::string &);
+
+  const std::string &str() const { return pattern; }
+
+  int find(const char *, const int) const;
+  bool in_name(const char *) const;
+};
+
+#endif
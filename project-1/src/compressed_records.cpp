@@ -0,0 +1,184 @@
+#include "compressed_records.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+const char MAGIC[4] = {'R', 'H', 'U', 'F'};
+
+CompressedRecords::CompressedRecords(const std::string &file_name,
+                                     const unsigned int file_size)
+    : file_name(file_name), file_size(file_size) {
+  handle.open(file_name, std::ios::in | std::ios::binary);
+  if (!handle.is_open())
+    throw std::runtime_error("Unable to open existing file " + file_name);
+
+  header h;
+  handle.read(reinterpret_cast<char *>(&h), sizeof h);
+  if (!handle || std::memcmp(h.magic, MAGIC, sizeof MAGIC))
+    throw std::runtime_error("Not a compressed records file: " + file_name);
+
+  // checks if saved file size equals current 'file_size'
+  if (h.file_size != file_size)
+    throw std::runtime_error("Unexpected file size. Expected size " +
+                             std::to_string(file_size) + " and got " +
+                             std::to_string(h.file_size));
+
+  code.reset(new Huffman(h.lengths));
+  pages.resize(h.n_pages);
+  handle.read(reinterpret_cast<char *>(pages.data()),
+              pages.size() * sizeof(page_entry));
+  if (!handle || h.n_pages != (file_size + PAGE_RECORDS - 1) / PAGE_RECORDS)
+    throw std::runtime_error("Corrupt compressed records file " + file_name);
+}
+
+void CompressedRecords::pack(const Record &r, std::string &packed) {
+  /* appends record 'r' to 'packed' without padding: a flag, then key, age
+  and list pointers and the name up to its terminator if it is filled. */
+
+  packed.push_back(r.good);
+  if (!r.good) return;
+
+  packed.append(reinterpret_cast<const char *>(&r.key), sizeof r.key);
+  packed.append(reinterpret_cast<const char *>(&r.age), sizeof r.age);
+  packed.append(reinterpret_cast<const char *>(&r.next), sizeof r.next);
+  packed.append(reinterpret_cast<const char *>(&r.prev), sizeof r.prev);
+  packed.append(r.name, strnlen(r.name, sizeof r.name - 1));
+  packed.push_back('\0');
+}
+
+Record CompressedRecords::unpack(const char *&packed) {
+  /* reads a record written by pack, advancing 'packed' past it. */
+
+  Record r;
+  std::memset(&r, 0, sizeof r);
+  r.good = *packed++;
+  r.next = r.prev = -1;
+  if (!r.good) return r;
+
+  std::memcpy(&r.key, packed, sizeof r.key);
+  packed += sizeof r.key;
+  std::memcpy(&r.age, packed, sizeof r.age);
+  packed += sizeof r.age;
+  std::memcpy(&r.next, packed, sizeof r.next);
+  packed += sizeof r.next;
+  std::memcpy(&r.prev, packed, sizeof r.prev);
+  packed += sizeof r.prev;
+  const std::size_t n = strnlen(packed, sizeof r.name - 1);
+  std::memcpy(r.name, packed, n);
+  packed += n + 1;
+  return r;
+}
+
+void CompressedRecords::write(
+    const std::string &file_name, const unsigned int file_size,
+    const std::function<Record(const unsigned int)> &read,
+    std::ostream &stream) {
+  /* writes a compressed image of a file to 'file_name', reading it twice:
+  once to count bytes and once to code them.
+  - 'read': function returning the record in a position of the file
+  - 'stream': ostream reference to output sizes before and after */
+
+  std::vector<unsigned long long> frequencies(Huffman::N_SYMBOLS);
+  std::string packed;
+  for (unsigned int i = 0; i < file_size; i++) {
+    packed.clear();
+    pack(read(i), packed);
+    for (const char c : packed) frequencies[(unsigned char)c]++;
+  }
+  const Huffman code(frequencies);
+
+  std::ofstream output(file_name, std::ios::binary | std::ios::trunc);
+  if (!output.is_open())
+    throw std::runtime_error("Unable to create file " + file_name);
+
+  header h;
+  std::memcpy(h.magic, MAGIC, sizeof MAGIC);
+  h.file_size = file_size;
+  h.n_pages = (file_size + PAGE_RECORDS - 1) / PAGE_RECORDS;
+  std::copy(code.lengths(), code.lengths() + Huffman::N_SYMBOLS, h.lengths);
+  output.write(reinterpret_cast<const char *>(&h), sizeof h);
+
+  // page entries are filled in once their pages are written
+  std::vector<page_entry> pages(h.n_pages);
+  output.write(reinterpret_cast<const char *>(pages.data()),
+               pages.size() * sizeof(page_entry));
+
+  std::string coded;
+  unsigned long long offset = sizeof h + pages.size() * sizeof(page_entry);
+  for (unsigned int page = 0; page < h.n_pages; page++) {
+    packed.clear();
+    const unsigned int end = std::min(file_size, (page + 1) * PAGE_RECORDS);
+    for (unsigned int i = page * PAGE_RECORDS; i < end; i++)
+      pack(read(i), packed);
+    coded.clear();
+    code.encode(packed, coded);
+    output.write(coded.data(), coded.size());
+
+    pages[page].offset = offset;
+    pages[page].compressed_size = coded.size();
+    pages[page].packed_size = packed.size();
+    offset += coded.size();
+  }
+
+  output.seekp(sizeof h);
+  output.write(reinterpret_cast<const char *>(pages.data()),
+               pages.size() * sizeof(page_entry));
+  if (!output) throw std::runtime_error("Unable to write file " + file_name);
+
+  stream << "arquivo compactado: " << (unsigned long long)file_size * sizeof(Record)
+         << " bytes em " << offset << " bytes" << std::endl;
+}
+
+void CompressedRecords::read_page(const unsigned int page, std::ifstream &input,
+                                  std::vector<Record> &records) const {
+  /* decodes page 'page' into 'records', reading it from 'input', an open
+  stream of the file, so threads can decode pages through their own. */
+
+  const page_entry &entry = pages[page];
+  std::vector<char> coded(entry.compressed_size);
+  input.seekg(entry.offset);
+  input.read(coded.data(), coded.size());
+  if (!input) throw std::runtime_error("Unable to read file " + file_name);
+
+  // a page's packed records are never longer than the records themselves,
+  // and the terminator keeps a damaged page from being unpacked past its end
+  std::vector<char> packed(entry.packed_size + sizeof(Record) + 1);
+  code->decode(coded.data(), coded.size(), packed.data(), entry.packed_size);
+
+  const unsigned int first = page * PAGE_RECORDS;
+  records.resize(file_size - first < PAGE_RECORDS ? file_size - first
+                                                 : PAGE_RECORDS);
+  const char *p = packed.data();
+  for (Record &r : records) {
+    if (p >= packed.data() + entry.packed_size)
+      throw std::runtime_error("Corrupt compressed records file " + file_name);
+    r = unpack(p);
+  }
+}
+
+Record CompressedRecords::read(const unsigned int pos) {
+  /* read record in 'pos' file position, decoding its page unless cached.
+  - 'pos': position in file to be read
+  - returns: record read */
+
+  const unsigned int page = pos / PAGE_RECORDS;
+  auto it = cached.find(page);
+  if (it != cached.end()) {
+    cache.splice(cache.begin(), cache, it->second);
+  } else {
+    if (cache.size() == CACHED_PAGES) {
+      cached.erase(cache.back().first);
+      cache.pop_back();
+    }
+    cache.emplace_front(page, std::vector<Record>());
+    try {
+      read_page(page, handle, cache.front().second);
+    } catch (...) {
+      cache.pop_front();
+      throw;
+    }
+    cached[page] = cache.begin();
+  }
+  return cache.front().second[pos % PAGE_RECORDS];
+}
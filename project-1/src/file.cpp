@@ -1,6 +1,25 @@
 #include "file.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "compressed_records.hpp"
+#include "pattern.hpp"
+
+// records read at once by scans, a whole number of compressed pages
+const unsigned int SCAN_BLOCK = 16 * CompressedRecords::PAGE_RECORDS;
+
+// appended to file name to name its compressed image
+const std::string COMPRESSED_SUFFIX = ".huf";
 
 std::istream &operator>>(std::istream &stream, Record &r) {
   stream >> r.key;
@@ -11,15 +30,23 @@ std::istream &operator>>(std::istream &stream, Record &r) {
   return stream;
 }
 
-File::File(const unsigned int file_size, const std::string &file_name)
-    : file_size(file_size), file_name(file_name) {
-  if (already_exists())
+File::File(const unsigned int file_size, const std::string &file_name,
+           const bool compressed)
+    : file_size(file_size), file_name(file_name), image_current(true) {
+  // a compressed image is only read, so the empty list is left unused
+  if (compressed) {
+    this->compressed.reset(
+        new CompressedRecords(file_name + COMPRESSED_SUFFIX, file_size));
+    empty_list_head = -1;
+  } else if (already_exists())
     open();
   else
     create();
 }
 
 File::~File() {
+  if (compressed) return;
+
   // updates header to file
   handle.seekg(sizeof file_size);
   handle.write(reinterpret_cast<const char *>(&empty_list_head),
@@ -56,6 +83,7 @@ void File::create() {
                              std::ios::trunc);
   if (!handle.is_open())
     throw std::runtime_error("Unable to create file " + file_name);
+  discard_image();
 
   // initialize next empty position pointer
   empty_list_head = file_size - 1;
@@ -102,6 +130,15 @@ void File::read_header() {
                              std::to_string(saved_file_size));
 }
 
+void File::discard_image() {
+  /* removes the compressed image of the file, if any, before its records
+  change, so it is never read in place of newer ones. */
+
+  if (!image_current) return;
+  std::remove((file_name + COMPRESSED_SUFFIX).c_str());
+  image_current = false;
+}
+
 unsigned int File::hash(const unsigned int key) {
   /* hashes 'key' with chosen hash function.
   - 'key': key to be hashed
@@ -115,6 +152,8 @@ void File::write(const Record &r, const unsigned int pos) {
   - 'r': record to be written to file
   - 'pos': position in file to write record to */
 
+  discard_image();
+
   // adjust file pointer, considering header space
   handle.seekg((sizeof file_size) + (sizeof empty_list_head) +
                pos * sizeof(Record));
@@ -127,6 +166,8 @@ Record File::read(const unsigned int pos) {
   - 'pos': position in file to be read
   - returns: record read */
 
+  if (compressed) return compressed->read(pos);
+
   // adjust file pointer to 'pos' position
   handle.seekg((sizeof file_size) + (sizeof empty_list_head) +
                pos * sizeof(Record));
@@ -185,6 +226,10 @@ void File::insert(Record &to_insert, std::ostream &stream) {
   - 'to_insert': reference to record to be inserted
   - 'stream': ostream reference to output operations log */
 
+  if (compressed)
+    throw std::runtime_error("Compressed file " + file_name +
+                             COMPRESSED_SUFFIX + " is read-only");
+
   const unsigned int key_hash = hash(to_insert.key);
   Record in_place = read(key_hash);
   if (!in_place.good) {
@@ -281,6 +326,10 @@ void File::remove(const unsigned int key, std::ostream &stream) {
   - 'key': key of record to be removed
   - 'stream': ostream reference to output operations log */
 
+  if (compressed)
+    throw std::runtime_error("Compressed file " + file_name +
+                             COMPRESSED_SUFFIX + " is read-only");
+
   const int index = search(key);
 
   // checks if search was successful
@@ -335,50 +384,185 @@ void File::remove(const unsigned int key, std::ostream &stream) {
   }
 }
 
-void File::print(std::ostream &stream) {
+void File::print(std::ostream &stream, const unsigned int threads) {
   /* output formatted file contents.
+  - 'stream': ostream reference to output operations log
+  - 'threads': number of threads to read and format records with */
+
+  scan_blocks(threads, [](Reader &, const unsigned int first,
+                          const Record *block, const unsigned int n,
+                          std::ostream &out) {
+    for (unsigned int i = 0; i < n; i++) print_entry(first + i, block[i], out);
+  }, stream);
+}
+
+void File::print_entry(const unsigned int i, const Record &r,
+                       std::ostream &stream) {
+  /* output record 'r', found in 'i' file position, as a line of print.
   - 'stream': ostream reference to output operations log */
 
-  for (unsigned int i = 0; i < file_size; i++) {
-    Record current = read(i);
-    stream << i << ": ";
+  stream << i << ": ";
+
+  // if position is not filled
+  if (!r.good)
+    stream << "vazio nulo";
+  else {
+    stream << r.key << " " << r.name << " " << r.age << " ";
 
-    // if position is not filled
-    if (!current.good)
-      stream << "vazio nulo";
-    else {
-      stream << current.key << " " << current.name << " " << current.age << " ";
+    if (r.next < 0)
+      stream << "nulo";
+    else
+      stream << r.next;
+  }
+  stream << std::endl;
+}
 
-      if (current.next < 0)
-        stream << "nulo";
-      else
-        stream << current.next;
+void File::scan(const std::string &pattern, std::ostream &stream,
+                const unsigned int threads) {
+  /* output records whose name contains 'pattern', in file order.
+  - 'pattern': substring to look for
+  - 'stream': ostream reference to output operations log
+  - 'threads': number of threads to scan with */
+
+  const Pattern p(pattern);
+  std::atomic<unsigned int> found(0);
+  scan_blocks(threads, [&](Reader &, const unsigned int first,
+                           const Record *block, const unsigned int n,
+                           std::ostream &out) {
+    for (unsigned int i = 0; i < n; i++)
+      if (block[i].good && p.in_name(block[i].name)) {
+        print_entry(first + i, block[i], out);
+        found++;
+      }
+  }, stream);
+
+  if (!found) stream << "nome nao encontrado: " << pattern << std::endl;
+}
+
+void File::scan_blocks(const unsigned int threads,
+                       const block_visitor &visit, std::ostream &stream) {
+  /* calls 'visit' on every block of consecutive records. threads take the
+  next block not taken yet and read it through a reader of their own,
+  staying at most two blocks per thread ahead of the next block whose
+  output is due, so output is kept for a bounded number of blocks.
+  - 'threads': number of threads to visit blocks with
+  - 'visit': function called with a reader for further records, the first
+  position of the block, its records, their number and a stream for output
+  - 'stream': ostream reference the output of blocks goes to in file order */
+
+  // readers use streams of their own, so pending writes go first
+  handle.flush();
+
+  const unsigned int n_blocks = (file_size + SCAN_BLOCK - 1) / SCAN_BLOCK;
+  const unsigned int n = std::max(1u, std::min(threads, n_blocks));
+  const unsigned int window = 2 * n;
+
+  std::mutex lock;
+  std::condition_variable changed;
+  std::map<unsigned int, std::string> done;
+  unsigned int next_block = 0, next_output = 0;
+  std::exception_ptr error;
+
+  std::vector<std::thread> workers;
+  for (unsigned int t = 0; t < n; t++)
+    workers.emplace_back([&]() {
+      try {
+        Reader reader(*this);
+        for (;;) {
+          unsigned int block;
+          {
+            std::unique_lock<std::mutex> l(lock);
+            changed.wait(l, [&]() {
+              return error || next_block == n_blocks ||
+                     next_block < next_output + window;
+            });
+            if (error || next_block == n_blocks) return;
+            block = next_block++;
+          }
+
+          const unsigned int first = block * SCAN_BLOCK;
+          const unsigned int count = std::min(SCAN_BLOCK, file_size - first);
+          std::ostringstream out;
+          visit(reader, first, reader.block(first, count), count, out);
+
+          std::lock_guard<std::mutex> l(lock);
+          done[block] = out.str();
+          changed.notify_all();
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> l(lock);
+        if (!error) error = std::current_exception();
+        changed.notify_all();
+      }
+    });
+
+  // output blocks in order as they are done
+  {
+    std::unique_lock<std::mutex> l(lock);
+    while (next_output < n_blocks) {
+      changed.wait(l, [&]() { return error || done.count(next_output); });
+      if (error) break;
+      const std::string out = std::move(done[next_output]);
+      done.erase(next_output++);
+      changed.notify_all();
+
+      l.unlock();
+      stream << out;
+      l.lock();
     }
-    stream << std::endl;
   }
+
+  for (std::thread &worker : workers) worker.join();
+  if (error) std::rethrow_exception(error);
 }
 
-void File::stats(std::ostream &stream) {
-  /* iterate over records computing average access time E(A).
+void File::compress(std::ostream &stream) {
+  /* writes a compressed image of the file next to it, which File reads
+  instead when constructed with 'compressed' set.
   - 'stream': ostream reference to output operations log */
 
-  unsigned int access_time = 0;
-  unsigned int number_of_records = 0;
-
-  for (unsigned int i = 0; i < file_size; i++) {
-    Record current = read(i);
+  if (compressed)
+    throw std::runtime_error("Compressed file " + file_name +
+                             COMPRESSED_SUFFIX + " is read-only");
 
-    if (current.good) {
-      number_of_records++;
-      access_time++;
+  handle.flush();
+  CompressedRecords::write(file_name + COMPRESSED_SUFFIX, file_size,
+                           [this](const unsigned int i) { return read(i); },
+                           stream);
+  image_current = true;
+}
 
-      // follow list backwards to compute access time of ith record
-      while (current.prev >= 0) {
-        current = read(current.prev);
-        access_time++;
+void File::stats(std::ostream &stream, const unsigned int threads) {
+  /* iterate over records computing average access time E(A).
+  - 'stream': ostream reference to output operations log
+  - 'threads': number of threads to read records with */
+
+  std::atomic<unsigned long long> access_time(0);
+  std::atomic<unsigned int> number_of_records(0);
+
+  scan_blocks(threads, [&](Reader &reader, const unsigned int,
+                           const Record *block, const unsigned int n,
+                           std::ostream &) {
+    // sum block's accesses, adding them to the totals once
+    unsigned long long block_access_time = 0;
+    unsigned int block_records = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      Record current = block[i];
+
+      if (current.good) {
+        block_records++;
+        block_access_time++;
+
+        // follow list backwards to compute access time of ith record
+        while (current.prev >= 0) {
+          current = reader.read(current.prev);
+          block_access_time++;
+        }
       }
     }
-  }
+    access_time += block_access_time;
+    number_of_records += block_records;
+  }, stream);
 
   if (!number_of_records)
     stream << "0.0" << std::endl;
@@ -389,3 +573,61 @@ void File::stats(std::ostream &stream) {
            << std::endl;
   }
 }
+
+File::Reader::Reader(const File &f) : f(f), page(-1) {
+  const std::string name =
+      (f.compressed ? f.file_name + COMPRESSED_SUFFIX : f.file_name);
+  in.open(name, std::ios::binary);
+  if (!in.is_open())
+    throw std::runtime_error("Unable to open existing file " + name);
+}
+
+const Record *File::Reader::block(const unsigned int first,
+                                  const unsigned int n) {
+  /* reads 'n' records from 'first' file position, which starts a page if
+  the file is compressed.
+  - returns: records read, followed by a spare record, so names can be
+  read past their end */
+
+  if (f.compressed) {
+    // decode each page of the block
+    blocks.clear();
+    const unsigned int page_size = CompressedRecords::PAGE_RECORDS;
+    for (unsigned int p = first / page_size; p * page_size < first + n; p++) {
+      f.compressed->read_page(p, in, records);
+      blocks.insert(blocks.end(), records.begin(), records.end());
+    }
+    page = -1;
+  } else {
+    blocks.resize(n);
+    in.seekg((sizeof f.file_size) + (sizeof f.empty_list_head) +
+             first * sizeof(Record));
+    in.read(reinterpret_cast<char *>(blocks.data()), n * sizeof(Record));
+    if (!in) throw std::runtime_error("Unable to read file " + f.file_name);
+  }
+
+  blocks.emplace_back();
+  return blocks.data();
+}
+
+Record File::Reader::read(const unsigned int pos) {
+  /* read record in 'pos' file position.
+  - returns: record read */
+
+  if (f.compressed) {
+    // keep the last page decoded
+    const unsigned int page_size = CompressedRecords::PAGE_RECORDS;
+    if (page != (int)(pos / page_size)) {
+      page = pos / page_size;
+      f.compressed->read_page(page, in, records);
+    }
+    return records[pos % page_size];
+  }
+
+  Record r;
+  in.seekg((sizeof f.file_size) + (sizeof f.empty_list_head) +
+           pos * sizeof(Record));
+  in.read(reinterpret_cast<char *>(&r), sizeof r);
+  if (!in) throw std::runtime_error("Unable to read file " + f.file_name);
+  return r;
+}
@@ -0,0 +1,158 @@
+#include "huffman.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+Huffman::Huffman(const std::vector<unsigned long long> &frequencies) {
+  /* builds the code of least expected length for bytes occurring with
+  'frequencies', then limits its lengths to MAX_LENGTH.
+  - 'frequencies': number of occurrences of each byte */
+
+  // merge the two least frequent trees until one is left, keeping parents
+  // to measure the depth of each leaf
+  typedef std::pair<unsigned long long, int> tree;
+  std::priority_queue<tree, std::vector<tree>, std::greater<tree>> trees;
+  std::vector<int> parent;
+  for (unsigned int c = 0; c < N_SYMBOLS; c++) {
+    length[c] = 0;
+    parent.push_back(-1);
+    if (frequencies[c]) trees.push(tree(frequencies[c], c));
+  }
+  while (trees.size() > 1) {
+    const tree a = trees.top();
+    trees.pop();
+    const tree b = trees.top();
+    trees.pop();
+    parent[a.second] = parent[b.second] = parent.size();
+    parent.push_back(-1);
+    trees.push(tree(a.first + b.first, parent.size() - 1));
+  }
+
+  for (unsigned int c = 0; c < N_SYMBOLS; c++) {
+    if (!frequencies[c]) continue;
+    int depth = 0;
+    for (int x = c; parent[x] >= 0; x = parent[x]) depth++;
+
+    // a lone symbol still needs one bit
+    length[c] = std::max(1, std::min(depth, (int)MAX_LENGTH + 1));
+  }
+
+  limit_lengths(frequencies);
+  assign_codes();
+}
+
+Huffman::Huffman(const unsigned char *lengths) {
+  /* rebuilds the code with the given 'lengths', as saved with a file. */
+
+  // kraft counts the code space used in units of 2^-MAX_LENGTH, which
+  // lengths of a code must not overflow
+  unsigned long long kraft = 0;
+  for (unsigned int c = 0; c < N_SYMBOLS; c++) {
+    if (lengths[c] > MAX_LENGTH)
+      throw std::runtime_error("Unexpected code length. Expected at most " +
+                               std::to_string(MAX_LENGTH) + " and got " +
+                               std::to_string(lengths[c]));
+    if (lengths[c]) kraft += 1ull << (MAX_LENGTH - lengths[c]);
+  }
+  if (kraft > 1ull << MAX_LENGTH)
+    throw std::runtime_error("Code lengths overflow the code space");
+
+  std::copy(lengths, lengths + N_SYMBOLS, length);
+  assign_codes();
+}
+
+void Huffman::limit_lengths(const std::vector<unsigned long long> &frequencies) {
+  /* shortens codes longer than MAX_LENGTH, then lengthens the longest codes
+  still shorter, least frequent first, until the lengths satisfy the Kraft
+  inequality again. */
+
+  // kraft counts the code space used in units of 2^-MAX_LENGTH
+  unsigned long long kraft = 0;
+  for (unsigned int c = 0; c < N_SYMBOLS; c++) {
+    if (length[c] > MAX_LENGTH) length[c] = MAX_LENGTH;
+    if (length[c]) kraft += 1ull << (MAX_LENGTH - length[c]);
+  }
+
+  while (kraft > 1ull << MAX_LENGTH) {
+    int chosen = -1;
+    for (unsigned int c = 0; c < N_SYMBOLS; c++)
+      if (length[c] && length[c] < MAX_LENGTH &&
+          (chosen < 0 || length[c] > length[chosen] ||
+           (length[c] == length[chosen] &&
+            frequencies[c] < frequencies[chosen])))
+        chosen = c;
+    length[chosen]++;
+    kraft -= 1ull << (MAX_LENGTH - length[chosen]);
+  }
+}
+
+void Huffman::assign_codes() {
+  /* numbers codes consecutively by length, then symbol, and fills the
+  decoding table: every entry whose first bits are a code decodes to it. */
+
+  std::vector<int> symbols;
+  for (unsigned int c = 0; c < N_SYMBOLS; c++)
+    if (length[c]) symbols.push_back(c);
+  std::sort(symbols.begin(), symbols.end(), [this](const int a, const int b) {
+    return length[a] != length[b] ? length[a] < length[b] : a < b;
+  });
+
+  std::fill(code, code + N_SYMBOLS, 0);
+  std::fill(table, table + (1 << MAX_LENGTH), entry{0, 0});
+  unsigned int next = 0, previous_length = 0;
+  for (const int c : symbols) {
+    next <<= length[c] - previous_length;
+    previous_length = length[c];
+    code[c] = next++;
+
+    const unsigned int first = code[c] << (MAX_LENGTH - length[c]);
+    for (unsigned int i = 0; i < 1u << (MAX_LENGTH - length[c]); i++)
+      table[first + i] = entry{(unsigned char)c, length[c]};
+  }
+}
+
+void Huffman::encode(const std::string &input, std::string &output) const {
+  /* appends the codes of the bytes of 'input' to 'output', first bit in
+  the highest bit of each byte, padding the last byte with zeros. */
+
+  std::uint64_t bits = 0;
+  unsigned int n_bits = 0;
+  for (const char c : input) {
+    bits = (bits << length[(unsigned char)c]) | code[(unsigned char)c];
+    n_bits += length[(unsigned char)c];
+    while (n_bits >= 8) {
+      n_bits -= 8;
+      output.push_back(bits >> n_bits);
+    }
+  }
+  if (n_bits) output.push_back(bits << (8 - n_bits));
+}
+
+void Huffman::decode(const char *input, const std::size_t input_size,
+                     char *output, const std::size_t output_size) const {
+  /* decodes 'output_size' bytes from 'input_size' bytes of codes.
+  - 'input': codes, as written by encode
+  - 'output': buffer to decode to */
+
+  // bits holds the next n_bits bits of input from its highest bit down,
+  // refilled a byte at a time and padded with zeros past the input's end
+  std::uint64_t bits = 0;
+  unsigned int n_bits = 0;
+  std::size_t in = 0;
+  for (std::size_t out = 0; out < output_size; out++) {
+    while (n_bits <= 56) {
+      const unsigned char byte = (in < input_size ? input[in++] : 0);
+      bits |= (std::uint64_t)byte << (56 - n_bits);
+      n_bits += 8;
+    }
+
+    const entry &e = table[bits >> (64 - MAX_LENGTH)];
+    output[out] = e.symbol;
+    bits <<= e.length;
+    n_bits -= e.length;
+  }
+}
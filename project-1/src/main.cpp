@@ -1,37 +1,143 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 #include "file.hpp"
+#include "frame_reader.hpp"
 
 const unsigned int TAMANHO_ARQUIVO = 11;
 
-int main() {
+std::uint32_t take_number(const char *&data, const char *end) {
+  /* reads a 32-bit number in the machine's byte order.
+  - 'data': position of number, moved past it
+  - returns: number read */
+
+  std::uint32_t x;
+  if (end - data < (std::ptrdiff_t)sizeof x)
+    throw std::runtime_error("Command frame too short");
+  std::memcpy(&x, data, sizeof x);
+  data += sizeof x;
+  return x;
+}
+
+bool run_frame(File &f, const FrameReader::Frame &frame,
+               const unsigned int threads, std::ostream &stream) {
+  /* runs the command in 'frame', its letter followed by its arguments:
+  numbers as 32-bit integers and the name or pattern as the remaining bytes.
+  - returns: 'false' if it ends input */
+
+  const char *data = frame.data, *end = frame.data + frame.size;
+  if (data == end) return true;
+  Record r;
+  switch (*data++) {
+    case 'i':
+      r.key = take_number(data, end);
+      r.age = take_number(data, end);
+      r.good = true;
+      std::memset(r.name, 0, sizeof r.name);
+      std::memcpy(r.name, data, std::min<std::size_t>(end - data, 20));
+      f.insert(r, stream);
+      break;
+    case 'c':
+      f.lookup(take_number(data, end), stream);
+      break;
+    case 'r':
+      f.remove(take_number(data, end), stream);
+      break;
+    case 'p':
+      f.print(stream, threads);
+      break;
+    case 'b':
+      f.scan(std::string(data, end), stream, threads);
+      break;
+    case 'm':
+      f.stats(stream, threads);
+      break;
+    case 'z':
+      f.compress(stream);
+      break;
+    case 'e':
+      return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
   char opt;
 
-  File f(TAMANHO_ARQUIVO);
+  // threads used by print, stats and scans, one per core unless given
+  // with -z, records are read from the file's compressed image
+  // with -f, commands are read in the binary format of run_frame
+  unsigned int threads = std::thread::hardware_concurrency();
+  bool compressed = false, framed = false;
+  for (int i = 1; i < argc; i++) {
+    if (!std::strcmp(argv[i], "-z"))
+      compressed = true;
+    else if (!std::strcmp(argv[i], "-f"))
+      framed = true;
+    else
+      threads = std::atoi(argv[i]);
+  }
+  if (!threads) threads = 1;
+
+  File f(TAMANHO_ARQUIVO, "records.log", compressed);
+  if (framed) {
+    try {
+      run_frames([&](const FrameReader::Frame &frame, std::ostream &stream) {
+        return run_frame(f, frame, threads, stream);
+      });
+    } catch (const std::runtime_error &e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
   Record r;
   unsigned int key;
+  std::string pattern;
 
   // handle input / output
+  // commands that fail, such as updates of compressed records, are reported
+  // and input goes on
   while (std::cin >> opt, opt != 'e') {
-    switch (opt) {
-      case 'i':
-        std::cin >> r;
-        f.insert(r, std::cout);
-        break;
-      case 'c':
-        std::cin >> key;
-        f.lookup(key, std::cout);
-        break;
-      case 'r':
-        std::cin >> key;
-        f.remove(key, std::cout);
-        break;
-      case 'p':
-        f.print(std::cout);
-        break;
-      case 'm':
-        f.stats(std::cout);
-        break;
+    try {
+      switch (opt) {
+        case 'i':
+          std::cin >> r;
+          f.insert(r, std::cout);
+          break;
+        case 'c':
+          std::cin >> key;
+          f.lookup(key, std::cout);
+          break;
+        case 'r':
+          std::cin >> key;
+          f.remove(key, std::cout);
+          break;
+        case 'p':
+          f.print(std::cout, threads);
+          break;
+        case 'b':
+          std::cin.ignore(1);
+          std::getline(std::cin, pattern);
+          f.scan(pattern, std::cout, threads);
+          break;
+        case 'm':
+          f.stats(std::cout, threads);
+          break;
+        case 'z':
+          f.compress(std::cout);
+          break;
+      }
+    } catch (const std::runtime_error &e) {
+      std::cerr << e.what() << std::endl;
     }
   }
 }
@@ -0,0 +1,106 @@
+#include "pattern.hpp"
+
+#include <algorithm>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "file.hpp"
+
+Pattern::Pattern(const std::string &pattern)
+    : pattern(pattern), delta_2(pattern.size()) {
+  const int m = pattern.size();
+
+  // distance from the last occurrence of each character to the end of the
+  // pattern, or its whole length if it does not occur
+  for (int c = 0; c < 256; c++) delta_1[c] = m;
+  for (int i = 0; i < m; i++)
+    delta_1[(unsigned char)pattern[i]] = m - 1 - i;
+
+  // a mismatch at the last character is left to delta_1
+  for (int j = 0; j < m - 1; j++)
+    delta_2[j] = m - rightmost_plausible_reoccurrence(j);
+  if (m) delta_2[m - 1] = 1;
+}
+
+int Pattern::rightmost_plausible_reoccurrence(const int j) {
+  /* finds the rightmost other place the suffix after position 'j' could
+  occur at, ie, the largest k <= j such that the pattern shifted to start
+  at k matches that suffix and does not have the mismatched character before
+  it. positions before the pattern's start match anything.
+  - 'j': position of the mismatch
+  - returns: k, possibly negative */
+
+  const int m = pattern.size();
+  for (int k = j;; k--) {
+    bool plausible = (k < 1 || pattern[k - 1] != pattern[j]);
+    for (int s = 0; plausible && s < m - j - 1; s++)
+      if (k + s >= 0 && pattern[k + s] != pattern[j + 1 + s])
+        plausible = false;
+    if (plausible) return k;
+  }
+}
+
+int Pattern::find(const char *text, const int n) const {
+  /* looks for the pattern in 'text'.
+  - 'text': text to search
+  - 'n': length of 'text'
+  - returns: position of the first occurrence, or -1 if there is none */
+
+  const int m = pattern.size();
+  if (!m) return 0;
+
+  int i = m - 1;
+  while (i < n) {
+    int j = m - 1;
+    while (j >= 0 && text[i] == pattern[j]) {
+      i--;
+      j--;
+    }
+    if (j < 0) return i + 1;
+    i += std::max(delta_1[(unsigned char)text[i]], delta_2[j]);
+  }
+  return -1;
+}
+
+bool Pattern::in_name(const char *name) const {
+  /* checks if the pattern occurs in a record's name.
+  - 'name': name of a Record followed by another one in memory, as the
+  vectorized path reads up to 35 bytes past the start of the name
+  - returns: 'true' if pattern was found, and 'false' otherwise */
+
+  const int m = pattern.size();
+  const int n = strnlen(name, sizeof(Record::name));
+  if (m > n) return false;
+
+#ifdef __SSE2__
+  if (m && m <= (int)SHORT_LENGTH) {
+    // flag positions where both the first and last characters match, and
+    // compare the ones in between only there
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[m - 1]);
+    for (int block = 0; block <= n - m; block += 16) {
+      const __m128i at_first = _mm_cmpeq_epi8(
+          first, _mm_loadu_si128(
+                     reinterpret_cast<const __m128i *>(name + block)));
+      const __m128i at_last = _mm_cmpeq_epi8(
+          last, _mm_loadu_si128(reinterpret_cast<const __m128i *>(
+                    name + block + m - 1)));
+      unsigned int candidates =
+          _mm_movemask_epi8(_mm_and_si128(at_first, at_last));
+
+      // drop positions past the last one the pattern fits at
+      if (n - m - block < 15) candidates &= (2u << (n - m - block)) - 1;
+      for (; candidates; candidates &= candidates - 1) {
+        const int i = block + __builtin_ctz(candidates);
+        if (m <= 2 || !std::memcmp(name + i + 1, pattern.data() + 1, m - 2))
+          return true;
+      }
+    }
+    return false;
+  }
+#endif
+
+  return find(name, n) >= 0;
+}
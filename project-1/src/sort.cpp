@@ -0,0 +1,47 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "external_sort.hpp"
+#include "file.hpp"
+
+// records are sorted by key, the order b::tree bulk_load and merge take
+struct KeyLess {
+  bool operator()(const Record &a, const Record &b) const {
+    return a.key < b.key;
+  }
+};
+
+template <typename T, typename Less>
+void sort(const char *input, const char *output, const std::size_t memory,
+          const unsigned int threads) {
+  ExternalSort<T, Less> sorter(memory, threads);
+  sorter.sort(input, output);
+  std::cout << sorter.runs() << " runs, " << sorter.merges() << " merges"
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 4 || (std::strcmp(argv[1], "-r") && std::strcmp(argv[1], "-k"))) {
+    std::cerr << "usage: " << argv[0]
+              << " -r|-k input output [memory_mb] [threads]" << std::endl
+              << "  -r: input holds Records, sorted by key" << std::endl
+              << "  -k: input holds unsigned int keys" << std::endl;
+    return 1;
+  }
+
+  const std::size_t memory =
+      (argc > 4 ? std::atof(argv[4]) : 64) * (1 << 20);
+  const unsigned int threads = (argc > 5 ? std::atoi(argv[5]) : 1);
+
+  try {
+    if (!std::strcmp(argv[1], "-r"))
+      sort<Record, KeyLess>(argv[2], argv[3], memory, threads);
+    else
+      sort<unsigned int, std::less<unsigned int>>(argv[2], argv[3], memory,
+                                                  threads);
+  } catch (const std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,23 @@
+#ifndef CORPUS_HPP
+#define CORPUS_HPP
+
+#include <string>
+#include <unordered_map>
+
+namespace corpus {
+struct counts {
+  std::unordered_map<std::string, int> unigrams;
+
+  // keyed by the words separated by spaces
+  std::unordered_map<std::string, int> bigrams;
+
+  // sequences of three or more words, keyed like bigrams
+  std::unordered_map<std::string, int> ngrams;
+
+  void merge(const counts&);
+};
+
+counts count(const std::string&, const int, const int order = 2);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef COUNT_MIN_HPP
+#define COUNT_MIN_HPP
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CountMin {
+ public:
+  CountMin(const int, const int, const std::string& file_name = "bigrams.dat");
+  ~CountMin() = default;
+  CountMin(const CountMin&) = delete;
+  CountMin& operator=(const CountMin&) = delete;
+
+  int add(const unsigned long long, const int, const bool = true);
+  int estimate(const unsigned long long) const;
+  double error_bound() const;
+  double failure_probability() const;
+  long long get_total() const;
+  void save();
+
+ private:
+  const int width, depth;
+  const std::string file_name;
+
+  long long total;
+  std::vector<int> counters;
+  std::fstream handle;
+  mutable std::mutex lock;
+
+  std::size_t cell(const int, const unsigned long long) const;
+  void write(const std::size_t);
+  void write_header();
+};
+
+#endif
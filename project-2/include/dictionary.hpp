@@ -1,36 +1,108 @@
 #ifndef DICTIONARY_HPP
 #define DICTIONARY_HPP
 
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "corpus.hpp"
+#include "count_min.hpp"
+#include "ngram_table.hpp"
 #include "top_n.hpp"
 #include "trie.hpp"
 
 class Dictionary {
  public:
-  Dictionary();
+  // typing context of one typist
+  struct session {
+    session() : first_typed_word(true), last_typed_word_index(-1) {}
+    bool first_typed_word;
+    int last_typed_word_index;
+
+    // previous words for n-gram contexts, most recent last
+    std::deque<int> history;
+  };
+
+  // the dictionary is saved as an image written by ingest, dictionary.dat,
+  // and files of the words, frequencies and followups typed since, which
+  // ingest folds into the next image
+  // a positive sketch_width counts bigrams approximately in a Count-Min
+  // sketch of sketch_width x sketch_depth counters instead of exactly
+  // an ngram_order above 2 predicts followups from tables of up to
+  // ngram_order words trained by ingest, backing off to bigrams
+  Dictionary(const int max_correction_distance = 2,
+             const int n_suggestions = 3, const int sketch_width = 0,
+             const int sketch_depth = 4, const int ngram_order = 2);
   ~Dictionary() = default;
 
   int insert(const std::string&);
   bool type_word(const std::string&, std::ostream&);
-  void print_frequencies(std::ostream&);
+  bool type_word(session&, const std::string&, std::ostream&);
+  void print_frequencies(std::ostream&) const;
   int query_correctness(const std::string&) const;
   void update_word_sequencing(const int);
+  void update_word_sequencing(session&, const int);
   void print_followup_frequencies(const std::string&, std::ostream&) const;
+  void print_completions(const std::string&, std::ostream&) const;
+  void ingest(const std::string&, const int);
+  void print_bigram_error(std::ostream&) const;
 
  private:
-  Trie whole_words, partial_words;
+  static const int N_WORD_LOCKS = 64;
+
+  Trie whole_words;
   std::vector<std::string> words;
-  std::vector<int> abs_frequencies;
+  std::deque<std::atomic<int>> abs_frequencies;
   std::vector<top_n<int>> relative_frequencies;
-  bool first_typed_word;
-  int last_typed_word_index;
+  const int max_correction_distance;
+  const int n_suggestions;
+  const int ngram_order;
+  session default_session;
+  std::unique_ptr<CountMin> bigrams;
+
+  // exact counts of word pairs, keyed by pair_key: those saved in the image,
+  // sorted, and those updated since, sharded like word_locks
+  std::vector<std::pair<unsigned long long, int>> saved_pairs;
+  std::unordered_map<unsigned long long, int> updated_pairs[N_WORD_LOCKS];
+
+  // ngram_tables[k] holds sequences of k + 3 words
+  std::vector<std::unique_ptr<NgramTable>> ngram_tables;
+
+  // insertions lock exclusively, everything else shares
+  mutable std::shared_timed_mutex words_lock;
+
+  // guard relative frequencies and files of words, sharded by index
+  mutable std::mutex word_locks[N_WORD_LOCKS];
+
+  std::mutex& word_lock(const int index) const {
+    return word_locks[index % N_WORD_LOCKS];
+  }
+
+  static unsigned long long pair_key(const int i, const int j) {
+    return ((unsigned long long)i << 32) | (unsigned int)j;
+  }
 
+  int add(const std::string&);
+  int append(const std::string&);
+  void restore();
+  void replay_typed_files();
+  void write_image(const std::string&) const;
+  int find(const std::string&) const;
+  void record_word(session&, const int);
   int retrieve_relative_frequency(const int, const int) const;
-  std::vector<int> get_most_frequent_followups(const int) const;
+  int add_relative_frequency(const int, const int, const int);
+  void save_followups(const int) const;
+  std::vector<int> get_most_frequent_followups(const session&,
+                                               const int) const;
+  void build_ngram_tables(const corpus::counts&,
+                          const std::unordered_map<std::string, int>&);
   std::vector<int> get_most_plausible_corrections(const std::string&) const;
 };
 
@@ -0,0 +1,72 @@
+#ifndef NGRAM_TABLE_HPP
+#define NGRAM_TABLE_HPP
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// read-only table of the followers of each context of order - 1 words, with
+// their full counts, memory-mapped from a file with layout
+//   header:  magic, order, n_contexts
+//   index:   n_blocks x (order - 1 word indices of the block's first
+//            context, byte offset of the block), plus a sentinel whose
+//            offset is the size of the blocks
+//   blocks:  BLOCK_CONTEXTS sorted contexts each, as varints
+// within a block, every context after the first is stored as the length of
+// the prefix it shares with the previous one, the increase of its next word
+// and its remaining words, and each context is followed by its number of
+// followers, their size in bytes and the followers, most frequent first, as
+// (word index, decrease of count) pairs
+class NgramTable {
+ public:
+  typedef std::map<std::vector<int>, std::vector<std::pair<int, int>>>
+      followers_map;
+
+  static const std::uint32_t BLOCK_CONTEXTS = 16;
+
+  NgramTable(const std::string&);
+  ~NgramTable();
+  NgramTable(const NgramTable&) = delete;
+  NgramTable& operator=(const NgramTable&) = delete;
+
+  bool is_open() const { return data != nullptr; }
+  std::vector<std::pair<int, int>> query(
+      const std::vector<int>&,
+      const std::size_t = std::numeric_limits<std::size_t>::max()) const;
+  void load(followers_map&) const;
+
+  static void write(const std::string&, const int, const followers_map&);
+
+ private:
+  // position in a block being decoded, at the followers of 'context'
+  struct cursor {
+    const unsigned char* p;
+    const unsigned char* end;
+    std::uint32_t left;
+    bool first;
+    std::vector<int> context;
+    std::uint32_t n_followers;
+    const unsigned char* followers;
+    const unsigned char* followers_end;
+  };
+
+  const std::string file_name;
+
+  void* data;
+  std::size_t size;
+  std::uint32_t order, n_contexts, n_blocks;
+  const std::uint32_t* index;
+  const unsigned char* blocks;
+
+  int compare(const std::uint32_t*, const std::vector<int>&) const;
+  std::uint32_t read_varint(const unsigned char*&, const unsigned char*) const;
+  cursor open_block(const std::uint32_t) const;
+  bool next_context(cursor&) const;
+  void read_followers(const cursor&, std::vector<std::pair<int, int>>&,
+                      const std::size_t) const;
+};
+
+#endif
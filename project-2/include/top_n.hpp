@@ -1,61 +1,109 @@
 #ifndef TOP_N_HPP
 #define TOP_N_HPP
 
-#include <queue>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
 #include <vector>
 
-template <class T, class Compare = std::greater<int>>
+template <class T, class Hash = std::hash<T>>
 class top_n {
  public:
-  top_n(const int n) : n(n) {}
+  top_n(const int n) : n(n), stamp(0) {}
   ~top_n() = default;
 
   void push(const T& key, const int freq) {
-    bool should_insert = true;
-
-    int size = keys.size();
-    // prevent repeated key insertion
-    for (int i = 0; i < size; i++)
-      if (keys[i] == key) {
-        // update frequency
-        freqs[i] = freq;
-
-        // insert and keep sorted
-        for (int j = i - 1; j >= 0 && freqs[j] < freqs[j + 1]; j--) {
-          std::swap(freqs[j], freqs[j + 1]);
-          std::swap(keys[j], keys[j + 1]);
-        }
-
-        should_insert = false;
-      }
-
-    if (should_insert) {
-      keys.push_back(key);
-      freqs.push_back(freq);
-
-      // restore ordering
-      for (int i = size - 1; i >= 0 && freqs[i] < freqs[i + 1]; i--) {
-        std::swap(freqs[i], freqs[i + 1]);
-        std::swap(keys[i], keys[i + 1]);
-      }
-
-      size++;
+    typename std::unordered_map<T, int, Hash>::iterator it = slots.find(key);
+    if (it != slots.end()) {
+      // update frequency and restore heap ordering
+      // the least frequent key sits at the root
+      const int i = it->second;
+      const bool increased = freq > heap[i].freq;
+      heap[i].freq = freq;
+      if (increased) {
+        // rank behind keys that already had this frequency
+        heap[i].stamp = stamp++;
+        sift_down(i);
+      } else
+        sift_up(i);
+    } else if ((int)heap.size() < n) {
+      heap.push_back(entry{key, freq, stamp++});
+      slots[key] = heap.size() - 1;
+      sift_up(heap.size() - 1);
+    } else if (n > 0 && freq > heap[0].freq) {
+      // replace least frequent key
+      slots.erase(heap[0].key);
+      heap[0] = entry{key, freq, stamp++};
+      slots[key] = 0;
+      sift_down(0);
     }
+  }
 
-    // discard extraneous
-    if (size > n) {
-      keys.pop_back();
-      freqs.pop_back();
-    }
+  std::vector<T> get_keys() const {
+    std::vector<entry> sorted = sorted_entries();
+    std::vector<T> keys;
+    keys.reserve(sorted.size());
+    for (const entry& e : sorted) keys.push_back(e.key);
+    return keys;
   }
 
-  const std::vector<int>& get_keys() const { return keys; }
-  const std::vector<int>& get_frequencies() const { return freqs; }
+  std::vector<int> get_frequencies() const {
+    std::vector<entry> sorted = sorted_entries();
+    std::vector<int> freqs;
+    freqs.reserve(sorted.size());
+    for (const entry& e : sorted) freqs.push_back(e.freq);
+    return freqs;
+  }
 
  private:
+  struct entry {
+    T key;
+    int freq;
+    unsigned long long stamp;
+  };
+
   const int n;
-  std::vector<T> keys;
-  std::vector<int> freqs;
+  unsigned long long stamp;
+  std::vector<entry> heap;
+  std::unordered_map<T, int, Hash> slots;
+
+  // a ranks below b if it is less frequent or, on ties, more recently pushed
+  static bool worse(const entry& a, const entry& b) {
+    return a.freq < b.freq || (a.freq == b.freq && a.stamp > b.stamp);
+  }
+
+  void swap_slots(const int i, const int j) {
+    std::swap(heap[i], heap[j]);
+    slots[heap[i].key] = i;
+    slots[heap[j].key] = j;
+  }
+
+  void sift_up(int i) {
+    while (i > 0 && worse(heap[i], heap[(i - 1) / 2])) {
+      swap_slots(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  }
+
+  void sift_down(int i) {
+    const int size = heap.size();
+    for (;;) {
+      int worst = i;
+      const int left = 2 * i + 1, right = 2 * i + 2;
+      if (left < size && worse(heap[left], heap[worst])) worst = left;
+      if (right < size && worse(heap[right], heap[worst])) worst = right;
+      if (worst == i) break;
+      swap_slots(i, worst);
+      i = worst;
+    }
+  }
+
+  std::vector<entry> sorted_entries() const {
+    std::vector<entry> sorted = heap;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const entry& a, const entry& b) { return worse(b, a); });
+    return sorted;
+  }
 };
 
 #endif
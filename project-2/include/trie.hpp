@@ -1,31 +1,73 @@
 #ifndef TRIE_HPP
 #define TRIE_HPP
 
+#include <array>
+#include <cstdint>
+#include <functional>
 #include <list>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace trie {
+// most completions a node caches
+const int MAX_COMPLETIONS = 4;
+
+struct completion {
+  int index, freq;
+};
+
 struct node {
+  node() : n_completions(0) {}
   ~node();
+
+  // children sorted by char
   std::list<std::pair<char, node*>> nodes;
   std::vector<int> indices;
+
+  // most frequent indices stored in this node's subtree, most frequent first
+  // and ties in the order they reached their frequency
+  std::array<completion, MAX_COMPLETIONS> completions;
+  int n_completions;
+
+  void cache(const int, const int, const int);
 };
 }
 
 class Trie {
  public:
-  Trie();
+  Trie(const int n_completions = 0);
   ~Trie();
 
   void insert(const std::string&, const int);
+  void update_frequency(const std::string&, const int, const int);
   std::vector<int> query(const std::string&) const;
-  std::vector<int> walk();
+  std::vector<int> complete(const std::string&) const;
+  std::vector<std::pair<int, int>> approximate_query(const std::string&,
+                                                     const int) const;
+  void walk(const std::function<void(const int)>&) const;
 
  private:
+  static const int N_COMPLETION_LOCKS = 64;
+
+  const int n_completions;
   trie::node* root;
 
-  std::vector<int> recursive_walk(trie::node*);
+  // guard completions caches, which change on every typed word, sharded by
+  // node so words typed at once only meet on their common prefixes
+  mutable std::mutex completion_locks[N_COMPLETION_LOCKS];
+
+  std::mutex& completion_lock(trie::node const* x) const {
+    return completion_locks[reinterpret_cast<std::uintptr_t>(x) /
+                            sizeof(trie::node) % N_COMPLETION_LOCKS];
+  }
+
+  trie::node* descend(const std::string&) const;
+  void recursive_approximate_query(trie::node const*, const char, const char,
+                                   const std::string&, const std::vector<int>&,
+                                   const std::vector<int>&, const int,
+                                   std::vector<std::pair<int, int>>&) const;
 };
 
 #endif
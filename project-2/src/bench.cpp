@@ -0,0 +1,183 @@
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "dictionary.hpp"
+
+namespace {
+typedef std::chrono::steady_clock timer;
+
+double seconds_since(const timer::time_point& start) {
+  return std::chrono::duration<double>(timer::now() - start).count();
+}
+
+std::vector<std::string> make_words(const int n, std::mt19937& rng) {
+  /* generates 'n' distinct lowercase words with 4 to 10 letters. */
+
+  std::uniform_int_distribution<int> length(4, 10), letter('a', 'z');
+  std::unordered_set<std::string> seen;
+  std::vector<std::string> words;
+  while ((int)words.size() < n) {
+    std::string word(length(rng), ' ');
+    for (char& c : word) c = letter(rng);
+    if (seen.insert(word).second) words.push_back(word);
+  }
+  return words;
+}
+
+std::string misspell(std::string word, std::mt19937& rng) {
+  /* applies one random substitution, insertion or deletion to 'word'. */
+
+  std::uniform_int_distribution<int> letter('a', 'z'), edit(0, 2);
+  const int pos = std::uniform_int_distribution<int>(0, word.size() - 1)(rng);
+  switch (edit(rng)) {
+    case 0:
+      word[pos] = (word[pos] == 'z' ? 'a' : word[pos] + 1);
+      break;
+    case 1:
+      word.insert(word.begin() + pos, letter(rng));
+      break;
+    default:
+      word.erase(word.begin() + pos);
+  }
+  return word;
+}
+
+long long total_frequency(const Dictionary& dict) {
+  /* returns: sum of the frequencies listed by print_frequencies */
+
+  std::stringstream listing;
+  dict.print_frequencies(listing);
+  long long total = 0;
+  std::string word;
+  for (int freq; listing >> word >> freq;) total += freq;
+  return total;
+}
+
+void report_latencies(const std::string& name, std::vector<double>& latencies) {
+  std::sort(latencies.begin(), latencies.end());
+  const int len = latencies.size();
+  std::cout << name << " p50 " << latencies[len / 2] * 1e6 << " us, p99 "
+            << latencies[len * 99 / 100] * 1e6 << " us" << std::endl;
+}
+}
+
+int main(int argc, char* argv[]) {
+  // usage: bench.out n_words [n_typed] [-x]
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " n_words [n_typed] [-x]"
+              << std::endl;
+    return 1;
+  }
+  const int n_words = std::stoi(argv[1]);
+  const int n_typed = (argc >= 3 && argv[2][0] != '-' ? std::stoi(argv[2])
+                                                       : 10000);
+
+  // exact mode restores by probing every pair file, quadratic in n_words
+  const bool exact = std::string(argv[argc - 1]) == "-x";
+  const int sketch_width = (exact ? 0 : 1 << 20);
+
+  // run in a scratch directory, since dictionaries persist to the cwd
+  const std::string dir = "bench-" + std::to_string(n_words);
+  if (std::system(("rm -rf " + dir).c_str()) != 0 ||
+      mkdir(dir.c_str(), 0755) != 0 || chdir(dir.c_str()) != 0) {
+    std::cerr << "unable to create " << dir << std::endl;
+    return 1;
+  }
+
+  std::mt19937 rng(54);
+  const std::vector<std::string> words = make_words(n_words, rng);
+  std::ostringstream discard;
+
+  std::cout << n_words << " words, " << (exact ? "exact" : "sketch")
+            << " bigrams" << std::endl;
+  {
+    Dictionary dict(2, 3, sketch_width);
+
+    // insert throughput
+    timer::time_point start = timer::now();
+    for (const std::string& word : words) dict.insert(word);
+    const double insert_time = seconds_since(start);
+    std::cout << "insert " << n_words / insert_time << " words/s" << std::endl;
+
+    // type_word latency for known words
+    std::uniform_int_distribution<int> pick(0, n_words - 1);
+    std::vector<double> latencies;
+    for (int i = 0; i < n_typed; i++) {
+      const std::string& word = words[pick(rng)];
+      start = timer::now();
+      dict.type_word(word, discard);
+      latencies.push_back(seconds_since(start));
+      discard.str("");
+    }
+    report_latencies("type_word known", latencies);
+
+    // type_word latency for misspellings
+    latencies.clear();
+    for (int i = 0; i < n_typed; i++) {
+      const std::string word = misspell(words[pick(rng)], rng);
+      start = timer::now();
+      dict.type_word(word, discard);
+      latencies.push_back(seconds_since(start));
+      discard.str("");
+    }
+    report_latencies("type_word misspelled", latencies);
+
+    // sessions typing known words at once, every word counted exactly once
+    const int n_sessions =
+        std::max(4, (int)std::thread::hardware_concurrency());
+    const long long before = total_frequency(dict);
+    std::vector<std::thread> sessions;
+    start = timer::now();
+    for (int t = 0; t < n_sessions; t++)
+      sessions.emplace_back([&, t]() {
+        std::mt19937 session_rng(t);
+        Dictionary::session session;
+        std::ostringstream output;
+        for (int i = 0; i < n_typed / n_sessions; i++) {
+          dict.type_word(session, words[pick(session_rng)], output);
+          output.str("");
+        }
+      });
+    for (std::thread& session : sessions) session.join();
+    const double sessions_time = seconds_since(start);
+    const long long typed = n_typed / n_sessions * n_sessions;
+    std::cout << n_sessions << " sessions " << typed / sessions_time
+              << " words/s" << std::endl;
+    if (total_frequency(dict) - before != typed) {
+      std::cerr << "sessions counted " << total_frequency(dict) - before
+                << " of " << typed << " typed words" << std::endl;
+      return 1;
+    }
+
+    // alphabetical frequency listing
+    start = timer::now();
+    dict.print_frequencies(discard);
+    std::cout << "print_frequencies " << seconds_since(start) << " s"
+              << std::endl;
+    discard.str("");
+  }
+
+  // restore from files
+  timer::time_point start = timer::now();
+  { Dictionary dict(2, 3, sketch_width); }
+  std::cout << "restore " << seconds_since(start) << " s" << std::endl;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  std::cout << "peak rss " << usage.ru_maxrss / 1024 << " MiB" << std::endl;
+
+  if (chdir("..") != 0 || std::system(("rm -rf " + dir).c_str()) != 0)
+    std::cerr << "unable to remove " << dir << std::endl;
+}
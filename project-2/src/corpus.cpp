@@ -0,0 +1,161 @@
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace corpus;
+
+namespace {
+const std::streamsize BLOCK_SIZE = 1 << 20;
+
+struct partition {
+  counts c;
+
+  // first and last order - 1 words, for sequences crossing partitions
+  std::vector<std::string> head;
+  std::deque<std::string> tail;
+};
+
+bool is_space(const char c) { return std::isspace((unsigned char)c); }
+
+void account(const std::string& word, const int order, partition& p) {
+  /* counts 'word' and the sequences of up to 'order' words it ends. */
+
+  p.c.unigrams[word]++;
+
+  std::string key = word;
+  const int len = p.tail.size();
+  for (int k = 1; k <= len; k++) {
+    key = p.tail[len - k] + " " + key;
+    if (k == 1)
+      p.c.bigrams[key]++;
+    else
+      p.c.ngrams[key]++;
+  }
+
+  if ((int)p.head.size() < order - 1) p.head.push_back(word);
+  p.tail.push_back(word);
+  if ((int)p.tail.size() > order - 1) p.tail.pop_front();
+}
+
+void count_range(const std::string& path, const std::streamoff begin,
+                 const std::streamoff end, const int order, partition& p) {
+  /* counts words starting in [begin, end) of file 'path'.
+  - 'p': partition receiving counts and the words at its boundaries */
+
+  std::ifstream input(path, std::ios::binary);
+  std::vector<char> block(BLOCK_SIZE);
+
+  // a word crossing begin belongs to the previous partition
+  std::streamoff pos = begin;
+  bool skipping = false;
+  if (begin > 0) {
+    input.seekg(begin - 1);
+    char c;
+    input.get(c);
+    skipping = !is_space(c);
+  }
+
+  std::string word;
+  std::streamoff word_begin = -1;
+  bool done = false;
+  while (!done) {
+    input.read(block.data(), BLOCK_SIZE);
+    const std::streamsize n = input.gcount();
+    if (n <= 0) break;
+
+    for (std::streamsize i = 0; i < n && !done; i++, pos++) {
+      const char c = block[i];
+      if (!is_space(c)) {
+        if (skipping) continue;
+        if (word.empty()) {
+          // words starting past the range belong to the next partition
+          if (pos >= end) {
+            done = true;
+            break;
+          }
+          word_begin = pos;
+        }
+        word += c;
+      } else {
+        skipping = false;
+        if (word.empty()) continue;
+
+        // account for finished word
+        account(word, order, p);
+        word.clear();
+      }
+    }
+  }
+
+  // account for a word ending at end of file
+  if (!word.empty() && word_begin < end) account(word, order, p);
+}
+}
+
+void counts::merge(const counts& other) {
+  for (const std::pair<const std::string, int>& x : other.unigrams)
+    unigrams[x.first] += x.second;
+  for (const std::pair<const std::string, int>& x : other.bigrams)
+    bigrams[x.first] += x.second;
+  for (const std::pair<const std::string, int>& x : other.ngrams)
+    ngrams[x.first] += x.second;
+}
+
+counts corpus::count(const std::string& path, const int n_threads,
+                     const int order) {
+  /* counts sequences of up to 'order' whitespace separated words in file
+  'path', splitting the file in 'n_threads' byte ranges counted in parallel.
+  - returns: merged counts */
+
+  std::ifstream input(path, std::ios::binary | std::ios::ate);
+  if (!input) throw std::runtime_error("Unable to open corpus " + path);
+  const std::streamoff size = input.tellg();
+  input.close();
+
+  // count each byte range in its own thread
+  const int n = std::max(1, n_threads), max_order = std::max(2, order);
+  std::vector<partition> partitions(n);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < n; i++)
+    workers.emplace_back(count_range, std::cref(path), size * i / n,
+                         size * (i + 1) / n, max_order,
+                         std::ref(partitions[i]));
+  for (std::thread& worker : workers) worker.join();
+
+  // merge partitions, including sequences across their boundaries
+  counts ret;
+  std::deque<std::string> tail;
+  for (partition& p : partitions) {
+    // count sequences ending at the ith word of p and starting before p
+    const int len = p.head.size();
+    for (int i = 0; i < len; i++) {
+      std::string key = p.head[i];
+      const int before = tail.size();
+      for (int k = 1; k < max_order && k - i <= before; k++) {
+        key = (k <= i ? p.head[i - k] : tail[before - (k - i)]) + " " + key;
+        if (k <= i) continue;
+        if (k == 1)
+          ret.bigrams[key]++;
+        else
+          ret.ngrams[key]++;
+      }
+    }
+
+    // last max_order - 1 words seen so far
+    for (const std::string& word : p.tail) tail.push_back(word);
+    while ((int)tail.size() > max_order - 1) tail.pop_front();
+
+    if (ret.unigrams.empty())
+      ret = std::move(p.c);
+    else
+      ret.merge(p.c);
+  }
+
+  return ret;
+}
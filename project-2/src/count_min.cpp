@@ -0,0 +1,143 @@
+#include "count_min.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+CountMin::CountMin(const int width, const int depth,
+                   const std::string& file_name)
+    : width(width), depth(depth), file_name(file_name), total(0) {
+  if (width < 1 || depth < 1)
+    throw std::runtime_error("Sketch dimensions must be positive");
+  counters.assign((std::size_t)width * depth, 0);
+
+  handle.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
+  if (handle.is_open()) {
+    // restore saved sketch, which must have the same dimensions
+    int saved_width, saved_depth;
+    handle.read(reinterpret_cast<char*>(&saved_width), sizeof saved_width);
+    handle.read(reinterpret_cast<char*>(&saved_depth), sizeof saved_depth);
+    if (saved_width != width || saved_depth != depth)
+      throw std::runtime_error(
+          "Unexpected sketch dimensions. Expected " + std::to_string(width) +
+          "x" + std::to_string(depth) + " and got " +
+          std::to_string(saved_width) + "x" + std::to_string(saved_depth));
+    handle.read(reinterpret_cast<char*>(&total), sizeof total);
+    handle.read(reinterpret_cast<char*>(counters.data()),
+                counters.size() * sizeof(int));
+  } else {
+    // create zeroed sketch
+    handle.open(file_name, std::ios::in | std::ios::out | std::ios::binary |
+                               std::ios::trunc);
+    if (!handle.is_open())
+      throw std::runtime_error("Unable to create file " + file_name);
+    write_header();
+    handle.write(reinterpret_cast<const char*>(counters.data()),
+                 counters.size() * sizeof(int));
+  }
+}
+
+std::size_t CountMin::cell(const int row, const unsigned long long key) const {
+  /* hashes 'key' into a counter of row 'row' with a per-row seeded
+  splitmix64 finalizer.
+  - returns: index of the counter in 'counters' */
+
+  unsigned long long x = key + (row + 1) * 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return (std::size_t)row * width + x % width;
+}
+
+void CountMin::write(const std::size_t i) {
+  /* writes counter 'i' to its place in the file. */
+
+  handle.seekp(sizeof width + sizeof depth + sizeof total + i * sizeof(int));
+  handle.write(reinterpret_cast<const char*>(&counters[i]), sizeof(int));
+}
+
+int CountMin::add(const unsigned long long key, const int count,
+                  const bool write_through) {
+  /* adds 'count' occurrences of 'key' with conservative update, raising only
+  the counters below the new estimate.
+  - 'write_through': whether to write raised counters to the file now,
+  rather than all at once by save
+  - returns: new estimate of 'key' occurrences */
+
+  std::lock_guard<std::mutex> guard(lock);
+
+  int estimate = counters[cell(0, key)];
+  for (int row = 1; row < depth; row++)
+    estimate = std::min(estimate, counters[cell(row, key)]);
+  estimate += count;
+
+  for (int row = 0; row < depth; row++) {
+    const std::size_t i = cell(row, key);
+    if (counters[i] < estimate) {
+      counters[i] = estimate;
+      if (write_through) write(i);
+    }
+  }
+
+  // update header
+  total += count;
+  if (write_through) {
+    handle.seekp(sizeof width + sizeof depth);
+    handle.write(reinterpret_cast<const char*>(&total), sizeof total);
+  }
+
+  return estimate;
+}
+
+void CountMin::write_header() {
+  handle.write(reinterpret_cast<const char*>(&width), sizeof width);
+  handle.write(reinterpret_cast<const char*>(&depth), sizeof depth);
+  handle.write(reinterpret_cast<const char*>(&total), sizeof total);
+}
+
+void CountMin::save() {
+  /* writes the whole sketch to a temporary file and renames it over the
+  saved one, so it is replaced at once. */
+
+  std::lock_guard<std::mutex> guard(lock);
+
+  const std::string tmp_name = file_name + ".tmp";
+  handle.close();
+  handle.open(tmp_name, std::ios::in | std::ios::out | std::ios::binary |
+                            std::ios::trunc);
+  if (!handle.is_open())
+    throw std::runtime_error("Unable to create file " + tmp_name);
+  write_header();
+  handle.write(reinterpret_cast<const char*>(counters.data()),
+               counters.size() * sizeof(int));
+  handle.flush();
+  if (!handle || std::rename(tmp_name.c_str(), file_name.c_str()) != 0)
+    throw std::runtime_error("Unable to replace " + file_name);
+}
+
+int CountMin::estimate(const unsigned long long key) const {
+  /* estimates occurrences of 'key', never underestimating them. */
+
+  std::lock_guard<std::mutex> guard(lock);
+
+  int estimate = counters[cell(0, key)];
+  for (int row = 1; row < depth; row++)
+    estimate = std::min(estimate, counters[cell(row, key)]);
+  return estimate;
+}
+
+double CountMin::error_bound() const {
+  /* returns: overestimate bound e * total / width, which holds for each
+  estimate with probability at least 1 - failure_probability() */
+
+  std::lock_guard<std::mutex> guard(lock);
+  return std::exp(1.0) * total / width;
+}
+
+double CountMin::failure_probability() const { return std::exp(-depth); }
+
+long long CountMin::get_total() const {
+  std::lock_guard<std::mutex> guard(lock);
+  return total;
+}
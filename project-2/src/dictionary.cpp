@@ -1,63 +1,349 @@
 #include "dictionary.hpp"
 
+#include <dirent.h>
+
 #include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <functional>
+#include <map>
 #include <queue>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+const std::string IMAGE_NAME = "dictionary.dat";
+
+// "DICT" in a little-endian file
+const std::uint32_t MAGIC = 0x54434944;
+const std::uint32_t VERSION = 1;
+
+// contents of a dictionary image, with layout
+//   header:  magic, version, n_words, n_pairs
+//   words:   n_words x (length, bytes, frequency)
+//   pairs:   n_pairs x (word index, followup index, count), sorted
+//   trailer: magic, so a partly written image is told apart
+struct image {
+  std::vector<std::string> words;
+  std::vector<int> frequencies;
+  std::vector<std::pair<unsigned long long, int>> pairs;
+};
+
+template <typename T>
+bool read_value(std::istream& input, T& x) {
+  return (bool)input.read(reinterpret_cast<char*>(&x), sizeof x);
+}
+
+template <typename T>
+void write_value(std::ostream& output, const T& x) {
+  output.write(reinterpret_cast<const char*>(&x), sizeof x);
+}
+
+void read_image(const std::string& file_name, image& saved) {
+  /* reads the dictionary image in 'file_name' into 'saved', checking it
+  whole before anything is used. */
+
+  std::ifstream input(file_name, std::ios::binary);
+  if (!input) throw std::runtime_error("Unable to open file " + file_name);
+  input.seekg(0, std::ios::end);
+  const std::streamoff size = input.tellg();
+  input.seekg(0);
+
+  const std::runtime_error invalid("Invalid dictionary image " + file_name);
+  std::uint32_t magic, version, n_words, n_pairs;
+  if (!read_value(input, magic) || !read_value(input, version) ||
+      !read_value(input, n_words) || !read_value(input, n_pairs) ||
+      magic != MAGIC || version != VERSION)
+    throw invalid;
+
+  for (std::uint32_t i = 0; i < n_words; i++) {
+    std::uint32_t length;
+    int frequency;
+    if (!read_value(input, length) || length > size - input.tellg())
+      throw invalid;
+    std::string word(length, '\0');
+    if (!input.read(&word[0], length) || !read_value(input, frequency))
+      throw invalid;
+    saved.words.push_back(word);
+    saved.frequencies.push_back(frequency);
+  }
+
+  for (std::uint32_t k = 0; k < n_pairs; k++) {
+    std::uint32_t i, j;
+    int count;
+    if (!read_value(input, i) || !read_value(input, j) ||
+        !read_value(input, count) || i >= n_words || j >= n_words)
+      throw invalid;
+    const unsigned long long key = ((unsigned long long)i << 32) | j;
+    if (!saved.pairs.empty() && saved.pairs.back().first >= key) throw invalid;
+    saved.pairs.emplace_back(key, count);
+  }
+
+  if (!read_value(input, magic) || magic != MAGIC ||
+      input.peek() != std::char_traits<char>::eof())
+    throw invalid;
+}
+
+// files written as words are typed, named after word indices i and j
+enum typed_file { NOT_TYPED, WORD_FILE, FREQ_FILE, PAIR_FILE, NEXT_FILE };
+
+typed_file parse_typed_file(const std::string& name, int& i, int& j) {
+  /* tells which file 'name' is of i-word.dat, i-freq.dat, i-j-freq.dat and
+  i-next.dat, if any.
+  - 'i', 'j': set to the word indices in the name */
+
+  std::size_t p = 0;
+  auto number = [&](int& x) {
+    long long value = 0;
+    const std::size_t first = p;
+    for (; p < name.size() && std::isdigit((unsigned char)name[p]); p++)
+      if ((value = 10 * value + (name[p] - '0')) > INT_MAX) return false;
+    x = value;
+    return p != first;
+  };
+
+  if (!number(i) || p == name.size() || name[p++] != '-') return NOT_TYPED;
+  if (p < name.size() && std::isdigit((unsigned char)name[p]))
+    return number(j) && name.substr(p) == "-freq.dat" ? PAIR_FILE : NOT_TYPED;
+
+  const std::string rest = name.substr(p);
+  if (rest == "word.dat") return WORD_FILE;
+  if (rest == "freq.dat") return FREQ_FILE;
+  if (rest == "next.dat") return NEXT_FILE;
+  return NOT_TYPED;
+}
+
+void for_each_typed_file(
+    const std::function<void(const std::string&, const typed_file, const int,
+                             const int)>& visit) {
+  /* lists the working directory once and visits the typed files in it. */
+
+  DIR* dir = opendir(".");
+  if (!dir) throw std::runtime_error("Unable to list the working directory");
+  std::vector<std::string> names;
+  while (const dirent* entry = readdir(dir)) names.push_back(entry->d_name);
+  closedir(dir);
+
+  for (const std::string& name : names) {
+    int i, j = -1;
+    const typed_file kind = parse_typed_file(name, i, j);
+    if (kind != NOT_TYPED) visit(name, kind, i, j);
+  }
+}
+
+void remove_typed_files() {
+  for_each_typed_file(
+      [](const std::string& name, const typed_file, const int, const int) {
+        std::remove(name.c_str());
+      });
+}
+
+void merge_pairs(std::vector<std::pair<unsigned long long, int>>& pairs,
+                 const std::vector<std::pair<unsigned long long, int>>& updates,
+                 const bool add) {
+  /* merges 'updates' into 'pairs', both sorted by key.
+  - 'add': whether counts of keys in both add up, instead of being replaced */
+
+  std::vector<std::pair<unsigned long long, int>> merged;
+  merged.reserve(pairs.size() + updates.size());
+  std::size_t a = 0, b = 0;
+  while (a < pairs.size() || b < updates.size())
+    if (b == updates.size() ||
+        (a < pairs.size() && pairs[a].first < updates[b].first))
+      merged.push_back(pairs[a++]);
+    else if (a == pairs.size() || updates[b].first < pairs[a].first)
+      merged.push_back(updates[b++]);
+    else {
+      merged.emplace_back(pairs[a].first,
+                          add ? pairs[a].second + updates[b].second
+                              : updates[b].second);
+      a++;
+      b++;
+    }
+  pairs.swap(merged);
+}
+}
+
+Dictionary::Dictionary(const int max_correction_distance,
+                       const int n_suggestions, const int sketch_width,
+                       const int sketch_depth, const int ngram_order)
+    : whole_words(n_suggestions),
+      max_correction_distance(max_correction_distance),
+      n_suggestions(n_suggestions),
+      ngram_order(ngram_order) {
+  if (sketch_width > 0)
+    bigrams.reset(new CountMin(sketch_width, sketch_depth));
+
+  // map trained n-gram tables
+  for (int order = 3; order <= ngram_order; order++)
+    ngram_tables.emplace_back(
+        new NgramTable(std::to_string(order) + "-grams.dat"));
+
+  restore();
+}
+
+void Dictionary::restore() {
+  // an image left by an interrupted ingest is its outcome if it was written
+  // whole, so its replacement is finished, and is dropped otherwise
+  image saved;
+  const std::string tmp_name = IMAGE_NAME + ".tmp";
+  bool replaced = false;
+  if (std::ifstream(tmp_name)) {
+    try {
+      read_image(tmp_name, saved);
+      replaced = true;
+    } catch (const std::runtime_error&) {
+      saved = image();
+      std::remove(tmp_name.c_str());
+    }
+    if (replaced) {
+      remove_typed_files();
+      if (std::rename(tmp_name.c_str(), IMAGE_NAME.c_str()) != 0)
+        throw std::runtime_error("Unable to replace " + IMAGE_NAME);
+    }
+  }
+  if (!replaced && std::ifstream(IMAGE_NAME)) read_image(IMAGE_NAME, saved);
+
+  // restore dictionary state from the image
+  const int n_words = saved.words.size();
+  for (int i = 0; i < n_words; i++) {
+    append(saved.words[i]);
+    abs_frequencies[i] = saved.frequencies[i];
+  }
+  for (const std::pair<unsigned long long, int>& x : saved.pairs)
+    relative_frequencies[x.first >> 32].push(x.first & 0xffffffff, x.second);
+  if (!bigrams) saved_pairs.swap(saved.pairs);
 
-Dictionary::Dictionary() {
-  first_typed_word = true;
-
-  // restore dictionary state
-  for (int i = 0;; i++) {
-    // read ith word from its file
-    std::ifstream input(std::to_string(i) + "-word.dat");
-    if (!input) break;
-    std::string word;
-    char c;
-    while (input >> c) word += c;
-    words.push_back(word);
-
-    // read ith word frequency from its file
-    std::ifstream freq_input(std::to_string(i) + "-freq.dat");
-    int abs_frequency;
-    freq_input >> abs_frequency;
-    abs_frequencies.push_back(abs_frequency);
-
-    // read ith word relative frequencies to all predecessors
-    relative_frequencies.push_back(top_n<int>(3));
-    for (int j = 0; j <= i; j++) {
-      relative_frequencies[i].push(j, retrieve_relative_frequency(i, j));
-      relative_frequencies[j].push(i, retrieve_relative_frequency(j, i));
+  replay_typed_files();
+
+  // rank words in trie
+  const int n = words.size();
+  for (int i = 0; i < n; i++)
+    whole_words.update_frequency(words[i], i, abs_frequencies[i]);
+}
+
+void Dictionary::replay_typed_files() {
+  // read what was typed since the image, in one pass over the directory
+  std::map<int, std::string> typed_words;
+  std::map<int, int> typed_frequencies;
+  std::vector<std::pair<std::pair<int, int>, int>> typed_pairs;
+  for_each_typed_file([&](const std::string& name, const typed_file kind,
+                          const int i, const int j) {
+    std::ifstream input(name);
+    switch (kind) {
+      case WORD_FILE: {
+        std::string word;
+        char c;
+        while (input >> c) word += c;
+        typed_words[i] = word;
+        break;
+      }
+      case FREQ_FILE:
+        input >> typed_frequencies[i];
+        break;
+      case PAIR_FILE: {
+        int relative_frequency;
+        if (!bigrams && input >> relative_frequency)
+          typed_pairs.push_back(
+              std::make_pair(std::make_pair(i, j), relative_frequency));
+        break;
+      }
+      case NEXT_FILE: {
+        int next, relative_frequency;
+        while (bigrams && input >> next >> relative_frequency)
+          typed_pairs.push_back(
+              std::make_pair(std::make_pair(i, next), relative_frequency));
+        break;
+      }
+      default:
+        break;
     }
+  });
 
-    // rebuild tries
-    whole_words.insert(word, i);
+  // words typed since the image follow its own, up to the first missing
+  for (int i = words.size(); typed_words.count(i); i++) append(typed_words[i]);
 
-    std::string partial_word;
-    const int len = word.size();
-    for (int j = 0; j < len; j++) {
-      partial_words.insert(partial_word + word.substr(j + 1), i);
-      partial_word += word[j];
+  const int n_words = words.size();
+  for (const std::pair<const int, int>& x : typed_frequencies)
+    if (x.first < n_words) abs_frequencies[x.first] = x.second;
+  for (const std::pair<std::pair<int, int>, int>& x : typed_pairs) {
+    const int i = x.first.first, j = x.first.second;
+    if (i >= n_words || j < 0 || j >= n_words) continue;
+    if (!bigrams) updated_pairs[i % N_WORD_LOCKS][pair_key(i, j)] = x.second;
+    relative_frequencies[i].push(j, x.second);
+  }
+}
+
+void Dictionary::write_image(const std::string& file_name) const {
+  /* writes the words with their frequencies and the exact counts of word
+  pairs, or in sketch mode the followups kept of each word, to
+  'file_name'. */
+
+  std::vector<std::pair<unsigned long long, int>> followups;
+  const std::vector<std::pair<unsigned long long, int>>* pairs = &saved_pairs;
+  const int n_words = words.size();
+  if (bigrams) {
+    for (int i = 0; i < n_words; i++) {
+      const std::vector<int> keys = relative_frequencies[i].get_keys();
+      const std::vector<int> freqs = relative_frequencies[i].get_frequencies();
+      const int len = keys.size();
+      for (int k = 0; k < len; k++)
+        followups.emplace_back(pair_key(i, keys[k]), freqs[k]);
     }
+    std::sort(followups.begin(), followups.end());
+    pairs = &followups;
+  }
+
+  std::ofstream output(file_name, std::ios::binary | std::ios::trunc);
+  if (!output) throw std::runtime_error("Unable to create file " + file_name);
+  write_value(output, MAGIC);
+  write_value(output, VERSION);
+  write_value(output, (std::uint32_t)n_words);
+  write_value(output, (std::uint32_t)pairs->size());
+  for (int i = 0; i < n_words; i++) {
+    write_value(output, (std::uint32_t)words[i].size());
+    output.write(words[i].data(), words[i].size());
+    write_value(output, abs_frequencies[i].load());
   }
+  for (const std::pair<unsigned long long, int>& x : *pairs) {
+    write_value(output, (std::uint32_t)(x.first >> 32));
+    write_value(output, (std::uint32_t)(x.first & 0xffffffff));
+    write_value(output, x.second);
+  }
+  write_value(output, MAGIC);
+
+  output.close();
+  if (!output) throw std::runtime_error("Unable to write file " + file_name);
 }
 
 int Dictionary::insert(const std::string& word) {
+  std::lock_guard<std::shared_timed_mutex> lock(words_lock);
+
+  // another session may have inserted word already
+  const int index = find(word);
+  if (index >= 0) return index;
+
+  return add(word);
+}
+
+int Dictionary::append(const std::string& word) {
   // add word to database
   const int index = words.size();
   words.push_back(word);
-  abs_frequencies.push_back(0);
-  relative_frequencies.push_back(top_n<int>(3));
+  abs_frequencies.emplace_back(0);
+  relative_frequencies.push_back(top_n<int>(n_suggestions));
 
-  // add word to tries
+  // add word to trie
   whole_words.insert(word, index);
 
-  std::string partial_word;
-  const int len = word.size();
-  for (int i = 0; i < len; i++) {
-    partial_words.insert(partial_word + word.substr(i + 1), index);
-    partial_word += word[i];
-  }
+  return index;
+}
+
+int Dictionary::add(const std::string& word) {
+  const int index = append(word);
 
   // create word file
   std::ofstream word_file(std::to_string(index) + "-word.dat");
@@ -70,13 +356,22 @@ int Dictionary::insert(const std::string& word) {
   return index;
 }
 
-void Dictionary::print_frequencies(std::ostream& os) {
-  std::vector<int> alpha_sorted = whole_words.walk();
-  for (int i : alpha_sorted)
-    os << words[i] << " " << abs_frequencies[i] << std::endl;
+void Dictionary::print_frequencies(std::ostream& os) const {
+  std::shared_lock<std::shared_timed_mutex> lock(words_lock);
+
+  // stream words in alphabetical order
+  whole_words.walk([&](const int i) {
+    os << words[i] << " " << abs_frequencies[i] << "\n";
+  });
+  os.flush();
 }
 
 int Dictionary::query_correctness(const std::string& word) const {
+  std::shared_lock<std::shared_timed_mutex> lock(words_lock);
+  return find(word);
+}
+
+int Dictionary::find(const std::string& word) const {
   std::vector<int> whole_query = whole_words.query(word);
 
   if (whole_query.empty())
@@ -86,13 +381,34 @@ int Dictionary::query_correctness(const std::string& word) const {
 }
 
 std::vector<int> Dictionary::get_most_frequent_followups(
-    const int index) const {
-  // find said words
-  std::vector<int> most_frequent_words_indices =
-      relative_frequencies[index].get_keys();
+    const session& s, const int index) const {
+  std::vector<int> most_frequent_words_indices;
+  auto suggest = [&](const int i) {
+    if ((int)most_frequent_words_indices.size() < n_suggestions &&
+        std::find(most_frequent_words_indices.begin(),
+                  most_frequent_words_indices.end(),
+                  i) == most_frequent_words_indices.end())
+      most_frequent_words_indices.push_back(i);
+  };
+
+  // find said words, backing off from the longest known context
+  const int history = s.history.size();
+  for (int order = ngram_order; order >= 3; order--) {
+    if (order - 2 > history) continue;
+    std::vector<int> context(s.history.end() - (order - 2), s.history.end());
+    context.push_back(index);
+    for (const std::pair<int, int>& x :
+         ngram_tables[order - 3]->query(context, n_suggestions))
+      suggest(x.first);
+  }
 
-  // complete 3 suggestions, if possible
-  if (most_frequent_words_indices.size() < 3) {
+  {
+    std::lock_guard<std::mutex> guard(word_lock(index));
+    for (const int i : relative_frequencies[index].get_keys()) suggest(i);
+  }
+
+  // complete n_suggestions suggestions, if possible
+  if ((int)most_frequent_words_indices.size() < n_suggestions) {
     const int n_words = words.size();
     for (int i = 0; i < n_words; i++) {
       bool already_suggested = false;
@@ -103,7 +419,7 @@ std::vector<int> Dictionary::get_most_frequent_followups(
         }
       if (!already_suggested) {
         most_frequent_words_indices.push_back(i);
-        if (most_frequent_words_indices.size() == 3) break;
+        if ((int)most_frequent_words_indices.size() == n_suggestions) break;
       }
     }
   }
@@ -112,66 +428,111 @@ std::vector<int> Dictionary::get_most_frequent_followups(
 }
 
 int Dictionary::retrieve_relative_frequency(const int i, const int j) const {
-  int relative_frequency;
-  std::ifstream relative_frequency_file(std::to_string(i) + "-" +
-                                        std::to_string(j) + "-freq.dat");
-  if (relative_frequency_file)
-    relative_frequency_file >> relative_frequency;
-  else
-    relative_frequency = 0;
-  return relative_frequency;
+  // pairs updated since the image shadow their saved counts
+  const unsigned long long key = pair_key(i, j);
+  const std::unordered_map<unsigned long long, int>& updated =
+      updated_pairs[i % N_WORD_LOCKS];
+  const std::unordered_map<unsigned long long, int>::const_iterator it =
+      updated.find(key);
+  if (it != updated.end()) return it->second;
+
+  const std::vector<std::pair<unsigned long long, int>>::const_iterator
+      saved = std::lower_bound(
+          saved_pairs.begin(), saved_pairs.end(), std::make_pair(key, 0),
+          [](const std::pair<unsigned long long, int>& a,
+             const std::pair<unsigned long long, int>& b) {
+            return a.first < b.first;
+          });
+  return saved != saved_pairs.end() && saved->first == key ? saved->second
+                                                           : 0;
 }
 
-void Dictionary::update_word_sequencing(const int index) {
-  if (first_typed_word)
-    first_typed_word = false;
+int Dictionary::add_relative_frequency(const int i, const int j,
+                                       const int count) {
+  int relative_frequency;
+  if (bigrams)
+    relative_frequency = bigrams->add(pair_key(i, j), count);
   else {
-    // update relative frequency in dataset
-    const int relative_frequency =
-        retrieve_relative_frequency(last_typed_word_index, index) + 1;
-    relative_frequencies[last_typed_word_index].push(index, relative_frequency);
+    relative_frequency = retrieve_relative_frequency(i, j) + count;
+    updated_pairs[i % N_WORD_LOCKS][pair_key(i, j)] = relative_frequency;
 
     // update/create relative frequncy file
-    std::ofstream relative_frequency_file(
-        std::to_string(last_typed_word_index) + "-" + std::to_string(index) +
-        "-freq.dat");
+    std::ofstream relative_frequency_file(std::to_string(i) + "-" +
+                                          std::to_string(j) + "-freq.dat");
     relative_frequency_file << relative_frequency;
   }
-  last_typed_word_index = index;
-  abs_frequencies[index]++;
 
-  // update freqs in files
-  std::ofstream freq_file(std::to_string(index) + "-freq.dat");
-  freq_file << abs_frequencies[index];
+  // update relative frequency in dataset
+  relative_frequencies[i].push(j, relative_frequency);
+
+  return relative_frequency;
 }
 
-std::vector<int> Dictionary::get_most_plausible_corrections(
-    const std::string& word) const {
-  // query substrings of words in substring of dictionary words
-  // taking only those that appear most frequently
-  const int len = word.size();
-  std::string subword;
-  top_n<int> filtered_indices(3);
-  for (int i = 0; i < len; i++) {
-    // query substring
-    std::vector<int> subword_query =
-        partial_words.query(subword + word.substr(i + 1));
+void Dictionary::save_followups(const int i) const {
+  // the sketch keeps no pairs, so save ith word top followups on their own
+  std::ofstream followups_file(std::to_string(i) + "-next.dat");
+  const std::vector<int> keys = relative_frequencies[i].get_keys();
+  const std::vector<int> freqs = relative_frequencies[i].get_frequencies();
+  const int len = keys.size();
+  for (int k = 0; k < len; k++)
+    followups_file << keys[k] << " " << freqs[k] << std::endl;
+}
 
-    // update three corrections as most frequent possible
-    for (const int index : subword_query)
-      filtered_indices.push(index, abs_frequencies[index]);
+void Dictionary::update_word_sequencing(const int index) {
+  update_word_sequencing(default_session, index);
+}
+
+void Dictionary::update_word_sequencing(session& s, const int index) {
+  std::shared_lock<std::shared_timed_mutex> lock(words_lock);
+  record_word(s, index);
+}
 
-    // update string
-    subword += word[i];
+void Dictionary::record_word(session& s, const int index) {
+  if (s.first_typed_word)
+    s.first_typed_word = false;
+  else {
+    std::lock_guard<std::mutex> guard(word_lock(s.last_typed_word_index));
+    add_relative_frequency(s.last_typed_word_index, index, 1);
+    if (bigrams) save_followups(s.last_typed_word_index);
   }
+  s.last_typed_word_index = index;
+  s.history.push_back(index);
+  if ((int)s.history.size() > std::max(ngram_order - 2, 0))
+    s.history.pop_front();
 
-  // retrieve corrections indices
-  std::vector<int> most_plausible_corrections_indices =
-      filtered_indices.get_keys();
+  // serialize updates of the same word so files never go back in time
+  std::lock_guard<std::mutex> guard(word_lock(index));
+  const int abs_frequency = ++abs_frequencies[index];
+  whole_words.update_frequency(words[index], index, abs_frequency);
+
+  // update freqs in files
+  std::ofstream freq_file(std::to_string(index) + "-freq.dat");
+  freq_file << abs_frequency;
+}
 
-  // complete 3 corrections, if possible
+std::vector<int> Dictionary::get_most_plausible_corrections(
+    const std::string& word) const {
+  // find dictionary words within max_correction_distance edits
+  std::vector<std::pair<int, int>> candidates =
+      whole_words.approximate_query(word, max_correction_distance);
+
+  // keep the n_suggestions most frequent words at each distance
+  std::vector<top_n<int>> filtered_indices(max_correction_distance + 1,
+                                           top_n<int>(n_suggestions));
+  for (const std::pair<int, int>& candidate : candidates)
+    filtered_indices[candidate.second].push(candidate.first,
+                                            abs_frequencies[candidate.first]);
+
+  // retrieve corrections indices, closest first
+  std::vector<int> most_plausible_corrections_indices;
+  for (const top_n<int>& same_distance : filtered_indices)
+    for (const int index : same_distance.get_keys())
+      if ((int)most_plausible_corrections_indices.size() < n_suggestions)
+        most_plausible_corrections_indices.push_back(index);
+
+  // complete n_suggestions corrections, if possible
   const int n_words = words.size();
-  if (most_plausible_corrections_indices.size() < 3) {
+  if ((int)most_plausible_corrections_indices.size() < n_suggestions) {
     for (int i = 0; i < n_words; i++) {
       bool already_suggested = false;
       for (int j : most_plausible_corrections_indices)
@@ -181,7 +542,8 @@ std::vector<int> Dictionary::get_most_plausible_corrections(
         }
       if (!already_suggested) {
         most_plausible_corrections_indices.push_back(i);
-        if (most_plausible_corrections_indices.size() == 3) break;
+        if ((int)most_plausible_corrections_indices.size() == n_suggestions)
+          break;
       }
     }
   }
@@ -190,16 +552,23 @@ std::vector<int> Dictionary::get_most_plausible_corrections(
 }
 
 bool Dictionary::type_word(const std::string& word, std::ostream& os) {
-  const int index = query_correctness(word);
+  return type_word(default_session, word, os);
+}
+
+bool Dictionary::type_word(session& s, const std::string& word,
+                           std::ostream& os) {
+  std::shared_lock<std::shared_timed_mutex> lock(words_lock);
+
+  const int index = find(word);
   if (index >= 0) {
     // print followup suggestions
     os << "proximas palavras:";
-    for (const int i : get_most_frequent_followups(index))
+    for (const int i : get_most_frequent_followups(s, index))
       os << " " << words[i];
     os << std::endl;
 
     // update followup frequencies
-    update_word_sequencing(index);
+    record_word(s, index);
 
     return true;
   } else {
@@ -215,13 +584,147 @@ bool Dictionary::type_word(const std::string& word, std::ostream& os) {
 
 void Dictionary::print_followup_frequencies(const std::string& word,
                                             std::ostream& os) const {
-  const int index = query_correctness(word);
+  std::shared_lock<std::shared_timed_mutex> lock(words_lock);
+
+  const int index = find(word);
   if (index >= 0) {
-    const std::vector<int>& keys = relative_frequencies[index].get_keys();
-    const std::vector<int>& freqs =
+    std::lock_guard<std::mutex> guard(word_lock(index));
+    const std::vector<int> keys = relative_frequencies[index].get_keys();
+    const std::vector<int> freqs =
         relative_frequencies[index].get_frequencies();
     const int len = keys.size();
     for (int i = 0; i < len; i++)
       if (freqs[i]) os << words[keys[i]] << " " << freqs[i] << std::endl;
   }
 }
+
+void Dictionary::print_completions(const std::string& prefix,
+                                   std::ostream& os) const {
+  std::shared_lock<std::shared_timed_mutex> lock(words_lock);
+
+  os << "possiveis complementos:";
+  for (const int i : whole_words.complete(prefix)) os << " " << words[i];
+  os << std::endl;
+}
+
+void Dictionary::ingest(const std::string& path, const int n_threads) {
+  // count corpus words and word pairs in parallel
+  corpus::counts counts = corpus::count(path, n_threads, ngram_order);
+
+  std::lock_guard<std::shared_timed_mutex> lock(words_lock);
+
+  // visit words in alphabetical order so new indices are deterministic
+  std::vector<std::pair<std::string, int>> unigrams(counts.unigrams.begin(),
+                                                    counts.unigrams.end());
+  std::sort(unigrams.begin(), unigrams.end());
+
+  // add unigram counts, inserting unknown words
+  std::unordered_map<std::string, int> indices;
+  for (const std::pair<std::string, int>& unigram : unigrams) {
+    int index = find(unigram.first);
+    if (index < 0) index = append(unigram.first);
+    indices[unigram.first] = index;
+
+    abs_frequencies[index] += unigram.second;
+    whole_words.update_frequency(unigram.first, index, abs_frequencies[index]);
+  }
+
+  // add bigram counts
+  std::vector<std::pair<unsigned long long, int>> counted;
+  for (const std::pair<const std::string, int>& bigram : counts.bigrams) {
+    const std::string::size_type separator = bigram.first.find(' ');
+    const int i = indices[bigram.first.substr(0, separator)];
+    const int j = indices[bigram.first.substr(separator + 1)];
+    if (bigrams)
+      relative_frequencies[i].push(
+          j, bigrams->add(pair_key(i, j), bigram.second, false));
+    else
+      counted.emplace_back(pair_key(i, j), bigram.second);
+  }
+
+  if (bigrams)
+    bigrams->save();
+  else {
+    // fold pairs updated since the image, then the corpus pairs, into it
+    std::vector<std::pair<unsigned long long, int>> updated;
+    for (std::unordered_map<unsigned long long, int>& shard : updated_pairs) {
+      updated.insert(updated.end(), shard.begin(), shard.end());
+      shard.clear();
+    }
+    std::sort(updated.begin(), updated.end());
+    merge_pairs(saved_pairs, updated, false);
+    std::sort(counted.begin(), counted.end());
+    merge_pairs(saved_pairs, counted, true);
+
+    for (const std::pair<unsigned long long, int>& x : counted)
+      relative_frequencies[x.first >> 32].push(
+          x.first & 0xffffffff,
+          retrieve_relative_frequency(x.first >> 32, x.first & 0xffffffff));
+  }
+
+  build_ngram_tables(counts, indices);
+
+  // replace the image, dropping the typed files it takes in first, so a
+  // restore after a crash in between finishes the replacement
+  const std::string tmp_name = IMAGE_NAME + ".tmp";
+  write_image(tmp_name);
+  remove_typed_files();
+  if (std::rename(tmp_name.c_str(), IMAGE_NAME.c_str()) != 0)
+    throw std::runtime_error("Unable to replace " + IMAGE_NAME);
+}
+
+void Dictionary::build_ngram_tables(
+    const corpus::counts& counts,
+    const std::unordered_map<std::string, int>& indices) {
+  for (int order = 3; order <= ngram_order; order++) {
+    // merge previous training with the new counts
+    std::map<std::vector<int>, std::unordered_map<int, int>> merged;
+    NgramTable::followers_map previous;
+    ngram_tables[order - 3]->load(previous);
+    for (const NgramTable::followers_map::value_type& x : previous)
+      for (const std::pair<int, int>& y : x.second)
+        merged[x.first][y.first] += y.second;
+
+    for (const std::pair<const std::string, int>& ngram : counts.ngrams) {
+      if (std::count(ngram.first.begin(), ngram.first.end(), ' ') != order - 1)
+        continue;
+
+      std::istringstream sequence(ngram.first);
+      std::vector<int> context;
+      std::string word;
+      while (sequence >> word) context.push_back(indices.at(word));
+      const int next = context.back();
+      context.pop_back();
+      merged[context][next] += ngram.second;
+    }
+
+    // keep every follower, most frequent first, so later training adds up
+    // as if the corpora had been ingested at once
+    NgramTable::followers_map entries;
+    for (const std::pair<const std::vector<int>, std::unordered_map<int, int>>&
+             x : merged) {
+      std::vector<std::pair<int, int>>& y = entries[x.first];
+      y.assign(x.second.begin(), x.second.end());
+      std::sort(y.begin(), y.end(),
+                [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+                  return a.second > b.second ||
+                         (a.second == b.second && a.first < b.first);
+                });
+    }
+
+    // replace and remap table
+    const std::string file_name = std::to_string(order) + "-grams.dat";
+    NgramTable::write(file_name, order, entries);
+    ngram_tables[order - 3].reset(new NgramTable(file_name));
+  }
+}
+
+void Dictionary::print_bigram_error(std::ostream& os) const {
+  if (!bigrams)
+    os << "contagem exata" << std::endl;
+  else
+    os << "contagem aproximada: " << bigrams->get_total()
+       << " pares, erro maximo " << bigrams->error_bound()
+       << " com probabilidade " << 1 - bigrams->failure_probability()
+       << std::endl;
+}
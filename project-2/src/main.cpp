@@ -1,10 +1,144 @@
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <thread>
 
 #include "dictionary.hpp"
+#include "frame_reader.hpp"
 
-int main() {
-  Dictionary dict;
+namespace {
+bool take_word(const char*& data, const char* end, std::string& word) {
+  /* reads the next word of a frame, words being separated by spaces.
+  - 'data': position to read from, moved past the word
+  - returns: 'false' if no word was left */
+
+  while (data != end && *data == ' ') data++;
+  const char* first = data;
+  while (data != end && *data != ' ') data++;
+  word.assign(first, data);
+  return data != first;
+}
+
+void type_word(Dictionary& dict, const std::string& word, const char*& data,
+               const char* end, std::ostream& stream) {
+  if (dict.type_word(word, stream)) return;
+
+  // treat retyped word as either insertion or correction
+  std::string retyped;
+  if (!take_word(data, end, retyped)) return;
+  int index = dict.query_correctness(retyped);
+  if (index >= 0)
+    dict.type_word(retyped, stream);
+  else {
+    index = dict.insert(retyped);
+    dict.update_word_sequencing(index);
+  }
+}
+
+bool run_frame(Dictionary& dict, const FrameReader::Frame& frame,
+               std::ostream& stream) {
+  /* runs the command in 'frame', its letter followed by its words, separated
+  by spaces: any number to insert, the typed word and its retyping, if
+  needed, or the single word queried.
+  - returns: 'false' if it ends input */
+
+  const char *data = frame.data, *end = frame.data + frame.size;
+  if (data == end) return true;
+  std::string word;
+  switch (*data++) {
+    case 'i':
+      while (take_word(data, end, word)) dict.insert(word);
+      break;
+    case 'd':
+      if (take_word(data, end, word)) type_word(dict, word, data, end, stream);
+      break;
+    case 'f':
+      dict.print_frequencies(stream);
+      break;
+    case 'p':
+      take_word(data, end, word);
+      dict.print_followup_frequencies(word, stream);
+      break;
+    case 'c':
+      take_word(data, end, word);
+      dict.print_completions(word, stream);
+      break;
+    case 's':
+      dict.print_bigram_error(stream);
+      break;
+    case 'e':
+      return false;
+  }
+  return true;
+}
+}
+
+int main(int argc, char* argv[]) {
+  // options:
+  //   -s width depth     approximate bigram counting
+  //   -n order           n-gram prediction up to order words
+  //   -b corpus [threads] bulk ingestion mode
+  //   -f                  commands in the binary format of run_frame
+  int sketch_width = 0, sketch_depth = 4, ngram_order = 2;
+  int n_threads = std::thread::hardware_concurrency();
+  std::string corpus;
+  bool framed = false;
+  for (int arg = 1; arg < argc;) {
+    const std::string opt = argv[arg];
+    if (opt == "-s" && arg + 2 < argc) {
+      sketch_width = std::stoi(argv[arg + 1]);
+      sketch_depth = std::stoi(argv[arg + 2]);
+      arg += 3;
+    } else if (opt == "-n" && arg + 1 < argc) {
+      ngram_order = std::stoi(argv[arg + 1]);
+      arg += 2;
+    } else if (opt == "-b" && arg + 1 < argc) {
+      corpus = argv[arg + 1];
+      arg += 2;
+      if (arg < argc && argv[arg][0] != '-') n_threads = std::stoi(argv[arg++]);
+    } else if (opt == "-f") {
+      framed = true;
+      arg++;
+    } else {
+      std::cerr << "unknown option " << opt << std::endl;
+      return 1;
+    }
+  }
+
+  // a dictionary that cannot be restored, such as one with a damaged image,
+  // is reported rather than started empty
+  std::unique_ptr<Dictionary> restored;
+  try {
+    restored.reset(
+        new Dictionary(2, 3, sketch_width, sketch_depth, ngram_order));
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  Dictionary& dict = *restored;
+
+  if (!corpus.empty()) {
+    try {
+      dict.ingest(corpus, n_threads);
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  if (framed) {
+    try {
+      run_frames([&](const FrameReader::Frame& frame, std::ostream& stream) {
+        return run_frame(dict, frame, stream);
+      });
+    } catch (const std::runtime_error& e) {
+      std::cerr << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
 
   // handle input / output
   char opt;
@@ -44,6 +178,15 @@ int main() {
         std::cin >> word;
         dict.print_followup_frequencies(word, std::cout);
         break;
+
+      case 'c':
+        std::cin >> word;
+        dict.print_completions(word, std::cout);
+        break;
+
+      case 's':
+        dict.print_bigram_error(std::cout);
+        break;
     }
   }
 }
@@ -0,0 +1,254 @@
+#include "ngram_table.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+// "NGRM" in a little-endian file
+const std::uint32_t MAGIC = 0x4d52474e;
+
+const std::size_t HEADER_SIZE = 3 * sizeof(std::uint32_t);
+
+void write_varint(std::string& output, std::uint32_t x) {
+  // 7 bits a byte, low first, the high bit set on all but the last
+  for (; x >= 0x80; x >>= 7) output += (char)(x | 0x80);
+  output += (char)x;
+}
+}
+
+const std::uint32_t NgramTable::BLOCK_CONTEXTS;
+
+NgramTable::NgramTable(const std::string& file_name)
+    : file_name(file_name), data(nullptr), size(0) {
+  // an absent table is just empty
+  const int fd = ::open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) return;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)HEADER_SIZE) {
+    ::close(fd);
+    throw std::runtime_error("Invalid n-gram table " + file_name);
+  }
+  size = st.st_size;
+  data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    data = nullptr;
+    throw std::runtime_error("Unable to map n-gram table " + file_name);
+  }
+
+  // read header and locate sections
+  const std::uint32_t* header = static_cast<const std::uint32_t*>(data);
+  order = header[1];
+  n_contexts = header[2];
+  n_blocks = (n_contexts + BLOCK_CONTEXTS - 1) / BLOCK_CONTEXTS;
+  index = header + 3;
+
+  // offsets inside blocks are checked as they are decoded
+  const std::size_t index_size =
+      ((std::size_t)n_blocks + 1) * order * sizeof(std::uint32_t);
+  if (header[0] != MAGIC || order < 2 || size < HEADER_SIZE + index_size ||
+      size - HEADER_SIZE - index_size !=
+          index[(std::size_t)n_blocks * order + order - 1]) {
+    munmap(data, size);
+    data = nullptr;
+    throw std::runtime_error("Invalid n-gram table " + file_name);
+  }
+  blocks = reinterpret_cast<const unsigned char*>(index) + index_size;
+}
+
+NgramTable::~NgramTable() {
+  if (data) munmap(data, size);
+}
+
+int NgramTable::compare(const std::uint32_t* context,
+                        const std::vector<int>& key) const {
+  /* compares a stored context with 'key' lexicographically.
+  - returns: negative, zero or positive as context is less, equal or greater */
+
+  for (std::uint32_t i = 0; i + 1 < order; i++)
+    if (context[i] != (std::uint32_t)key[i])
+      return context[i] < (std::uint32_t)key[i] ? -1 : 1;
+  return 0;
+}
+
+std::uint32_t NgramTable::read_varint(const unsigned char*& p,
+                                      const unsigned char* end) const {
+  /* decodes the varint at 'p', moving p past it. */
+
+  std::uint32_t x = 0;
+  for (int shift = 0; shift < 35 && p != end; shift += 7) {
+    const unsigned char c = *p++;
+    x |= (std::uint32_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) return x;
+  }
+  throw std::runtime_error("Corrupt n-gram table " + file_name);
+}
+
+NgramTable::cursor NgramTable::open_block(const std::uint32_t b) const {
+  /* returns: cursor before the first context of block 'b' */
+
+  const std::uint32_t* entry = index + (std::size_t)b * order;
+  const std::uint32_t begin = entry[order - 1], end = entry[2 * order - 1];
+  if (begin > end || end > index[(std::size_t)n_blocks * order + order - 1])
+    throw std::runtime_error("Corrupt n-gram table " + file_name);
+
+  cursor c;
+  c.p = blocks + begin;
+  c.end = blocks + end;
+  c.left = std::min(BLOCK_CONTEXTS, n_contexts - b * BLOCK_CONTEXTS);
+
+  // the first context is only stored in the index
+  c.first = true;
+  c.context.assign(entry, entry + order - 1);
+  return c;
+}
+
+bool NgramTable::next_context(cursor& c) const {
+  /* decodes the next context of a block and locates its followers.
+  - returns: 'false' past the last context of the block */
+
+  if (!c.left) return false;
+  if (c.first)
+    c.first = false;
+  else {
+    const std::uint32_t shared = read_varint(c.p, c.end);
+    if (shared + 1 >= order)
+      throw std::runtime_error("Corrupt n-gram table " + file_name);
+    c.context[shared] += read_varint(c.p, c.end);
+    for (std::uint32_t i = shared + 1; i + 1 < order; i++)
+      c.context[i] = read_varint(c.p, c.end);
+  }
+  c.left--;
+
+  c.n_followers = read_varint(c.p, c.end);
+  const std::uint32_t bytes = read_varint(c.p, c.end);
+  if (bytes > (std::size_t)(c.end - c.p))
+    throw std::runtime_error("Corrupt n-gram table " + file_name);
+  c.followers = c.p;
+  c.followers_end = c.p += bytes;
+  return true;
+}
+
+void NgramTable::read_followers(const cursor& c,
+                                std::vector<std::pair<int, int>>& followers,
+                                const std::size_t limit) const {
+  /* appends up to 'limit' followers of the context at cursor 'c'. */
+
+  const unsigned char* p = c.followers;
+  std::uint32_t count = 0;
+  for (std::uint32_t i = 0; i < c.n_followers && i < limit; i++) {
+    const int word = read_varint(p, c.followers_end);
+    const std::uint32_t decrease = read_varint(p, c.followers_end);
+    count = (i ? count - decrease : decrease);
+    followers.emplace_back(word, count);
+  }
+}
+
+std::vector<std::pair<int, int>> NgramTable::query(
+    const std::vector<int>& context, const std::size_t limit) const {
+  /* binary searches the block of 'context', then decodes it up to context.
+  - 'context': last order - 1 word indices
+  - 'limit': maximum number of followers returned
+  - returns: (word index, count) pairs, most frequent first */
+
+  std::vector<std::pair<int, int>> ret;
+  if (!data || context.size() + 1 != order) return ret;
+
+  // last block starting at or before context
+  std::uint32_t lo = 0, hi = n_blocks;
+  while (lo < hi) {
+    const std::uint32_t mid = lo + (hi - lo) / 2;
+    if (compare(index + (std::size_t)mid * order, context) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (!lo) return ret;
+
+  cursor c = open_block(lo - 1);
+  while (next_context(c))
+    if (c.context == context) {
+      read_followers(c, ret, limit);
+      break;
+    } else if (context < c.context)
+      break;
+
+  return ret;
+}
+
+void NgramTable::load(followers_map& entries) const {
+  /* appends every stored context and its followers to 'entries'. */
+
+  if (!data) return;
+  for (std::uint32_t b = 0; b < n_blocks; b++) {
+    cursor c = open_block(b);
+    while (next_context(c))
+      read_followers(c, entries[c.context],
+                     std::numeric_limits<std::size_t>::max());
+  }
+}
+
+void NgramTable::write(const std::string& file_name, const int order,
+                       const followers_map& entries) {
+  /* writes 'entries' as a table of given 'order' to a temporary file and
+  renames it over 'file_name', so mapped readers keep their old copy.
+  Followers of each context must be most frequent first. */
+
+  const std::string tmp_name = file_name + ".tmp";
+  std::ofstream output(tmp_name, std::ios::binary | std::ios::trunc);
+  if (!output) throw std::runtime_error("Unable to create file " + tmp_name);
+
+  // encode blocks, indexing the first context of each
+  std::vector<std::uint32_t> index;
+  std::string blocks, followers;
+  const std::vector<int>* previous = nullptr;
+  std::uint32_t n_contexts = 0;
+  for (const followers_map::value_type& x : entries) {
+    if (n_contexts++ % BLOCK_CONTEXTS == 0) {
+      index.insert(index.end(), x.first.begin(), x.first.end());
+      index.push_back(blocks.size());
+    } else {
+      const std::uint32_t shared =
+          std::mismatch(x.first.begin(), x.first.end(), previous->begin())
+              .first -
+          x.first.begin();
+      write_varint(blocks, shared);
+      write_varint(blocks, x.first[shared] - (*previous)[shared]);
+      for (std::uint32_t i = shared + 1; i < x.first.size(); i++)
+        write_varint(blocks, x.first[i]);
+    }
+    previous = &x.first;
+
+    followers.clear();
+    for (std::size_t i = 0; i < x.second.size(); i++) {
+      write_varint(followers, x.second[i].first);
+      write_varint(followers, i ? x.second[i - 1].second - x.second[i].second
+                                : x.second[i].second);
+    }
+    write_varint(blocks, x.second.size());
+    write_varint(blocks, followers.size());
+    blocks += followers;
+  }
+
+  // sentinel holding the end offset of the last block
+  index.insert(index.end(), order - 1, 0);
+  index.push_back(blocks.size());
+
+  const std::uint32_t header[] = {MAGIC, (std::uint32_t)order, n_contexts};
+  output.write(reinterpret_cast<const char*>(header), sizeof header);
+  output.write(reinterpret_cast<const char*>(index.data()),
+               index.size() * sizeof(std::uint32_t));
+  output.write(blocks.data(), blocks.size());
+
+  output.close();
+  if (!output || std::rename(tmp_name.c_str(), file_name.c_str()) != 0)
+    throw std::runtime_error("Unable to replace " + file_name);
+}
@@ -1,6 +1,7 @@
 #include "trie.hpp"
 
 #include <algorithm>
+#include <stdexcept>
 
 using namespace trie;
 
@@ -8,32 +9,86 @@ node::~node() {
   for (std::pair<char, node*> x : nodes) delete x.second;
 }
 
-Trie::Trie() { root = new node(); }
+void node::cache(const int index, const int freq, const int n) {
+  /* updates the frequency of 'index' among the cached completions, keeping
+  at most 'n'. */
+
+  int len = n_completions;
+  int i = 0;
+  while (i < len && completions[i].index != index) i++;
+  if (i < len) {
+    if (completions[i].freq == freq) return;
+    std::copy(completions.begin() + i + 1, completions.begin() + len,
+              completions.begin() + i);
+    len--;
+  } else if (len == n) {
+    // replace least frequent index
+    if (!n || freq <= completions[len - 1].freq) return;
+    len--;
+  }
+
+  // shift less frequent indices back, ranking behind equally frequent ones
+  int j = len;
+  for (; j > 0 && completions[j - 1].freq < freq; j--)
+    completions[j] = completions[j - 1];
+  completions[j] = completion{index, freq};
+  n_completions = len + 1;
+}
+
+Trie::Trie(const int n_completions) : n_completions(n_completions) {
+  if (n_completions < 0 || n_completions > MAX_COMPLETIONS)
+    throw std::runtime_error(
+        "Unexpected number of completions. Expected at most " +
+        std::to_string(MAX_COMPLETIONS) + " and got " +
+        std::to_string(n_completions));
+  root = new node();
+}
 Trie::~Trie() { delete root; }
 
 void Trie::insert(const std::string& word, const int index) {
   node* x = root;
   for (char c : word) {
-    bool found = false;
-    for (const std::pair<char, node*>& y : x->nodes)
-      if (y.first == c) {
-        found = true;
-        x = y.second;
-        break;
-      }
+    // find child or the position keeping children sorted
+    std::list<std::pair<char, node*>>::iterator it = x->nodes.begin();
+    while (it != x->nodes.end() && it->first < c) it++;
 
-    if (!found) {
+    if (it != x->nodes.end() && it->first == c)
+      x = it->second;
+    else {
       node* y = new node();
-      x->nodes.emplace_front(c, y);
+      x->nodes.emplace(it, c, y);
       x = y;
     }
   }
 
   x->indices.push_back(index);
+
+  // new words start with no occurrences
+  update_frequency(word, index, 0);
 }
 
-std::vector<int> Trie::query(const std::string& word) const {
-  node const* x = root;
+void Trie::update_frequency(const std::string& word, const int index,
+                            const int freq) {
+  // refresh cached completions of every prefix of word, holding one node's
+  // lock at a time
+  node* x = root;
+  for (std::string::const_iterator it = word.begin();; it++) {
+    {
+      std::lock_guard<std::mutex> guard(completion_lock(x));
+      x->cache(index, freq, n_completions);
+    }
+    if (it == word.end()) break;
+
+    for (const std::pair<char, node*>& y : x->nodes)
+      if (y.first == *it) {
+        x = y.second;
+        break;
+      }
+  }
+}
+
+node* Trie::descend(const std::string& word) const {
+  node* x = root;
   for (char c : word) {
     bool found = false;
     for (const std::pair<char, node*>& y : x->nodes)
@@ -43,30 +98,96 @@ std::vector<int> Trie::query(const std::string& word) const {
         break;
       }
 
-    if (!found) return std::vector<int>();
+    if (!found) return nullptr;
   }
 
+  return x;
+}
+
+std::vector<int> Trie::query(const std::string& word) const {
+  node const* x = descend(word);
+  if (!x) return std::vector<int>();
   return x->indices;
 }
 
-std::vector<int> Trie::walk() {
-  node* x = root;
-  return recursive_walk(x);
+std::vector<int> Trie::complete(const std::string& prefix) const {
+  node const* x = descend(prefix);
+  if (!x) return std::vector<int>();
+
+  std::vector<int> ret;
+  std::lock_guard<std::mutex> guard(completion_lock(x));
+  for (int i = 0; i < x->n_completions; i++)
+    ret.push_back(x->completions[i].index);
+  return ret;
 }
 
-std::vector<int> Trie::recursive_walk(node* x) {
-  // sort nodes by char
-  x->nodes.sort(
-      [](const std::pair<char, node*>& a, const std::pair<char, node*>& b) {
-        return a.first < b.first;
-      });
-
-  // recursively obtain indices for child nodes
-  std::vector<int> ret = x->indices;
-  for (const std::pair<char, node*> y : x->nodes) {
-    std::vector<int> sub_ret = recursive_walk(y.second);
-    std::copy(sub_ret.begin(), sub_ret.end(), std::back_inserter(ret));
-  }
+std::vector<std::pair<int, int>> Trie::approximate_query(
+    const std::string& word, const int max_distance) const {
+  // edit distances from the empty prefix to every prefix of word
+  const int len = word.size();
+  std::vector<int> row(len + 1);
+  for (int i = 0; i <= len; i++) row[i] = i;
+
+  // retrieve (index, distance) of words within max_distance edits
+  std::vector<std::pair<int, int>> ret;
+  if (row[len] <= max_distance)
+    for (const int index : root->indices) ret.emplace_back(index, row[len]);
+  for (const std::pair<char, node*>& y : root->nodes)
+    recursive_approximate_query(y.second, y.first, '\0', word,
+                                std::vector<int>(), row, max_distance, ret);
 
   return ret;
 }
+
+void Trie::recursive_approximate_query(
+    node const* x, const char c, const char prev_c, const std::string& word,
+    const std::vector<int>& prev_prev_row, const std::vector<int>& prev_row,
+    const int max_distance, std::vector<std::pair<int, int>>& ret) const {
+  // compute next row of the optimal string alignment distance matrix
+  const int len = word.size();
+  std::vector<int> row(len + 1);
+  row[0] = prev_row[0] + 1;
+  int row_min = row[0];
+  for (int i = 1; i <= len; i++) {
+    const int cost = (word[i - 1] == c ? 0 : 1);
+    row[i] = std::min(std::min(row[i - 1], prev_row[i]) + 1,
+                      prev_row[i - 1] + cost);
+
+    // adjacent transposition
+    if (i > 1 && !prev_prev_row.empty() && word[i - 1] == prev_c &&
+        word[i - 2] == c)
+      row[i] = std::min(row[i], prev_prev_row[i - 2] + 1);
+
+    row_min = std::min(row_min, row[i]);
+  }
+
+  if (row[len] <= max_distance)
+    for (const int index : x->indices) ret.emplace_back(index, row[len]);
+
+  // no word below this node can get back within max_distance
+  if (row_min > max_distance) return;
+
+  for (const std::pair<char, node*>& y : x->nodes)
+    recursive_approximate_query(y.second, y.first, c, word, prev_row, row,
+                                max_distance, ret);
+}
+
+void Trie::walk(const std::function<void(const int)>& visit) const {
+  // preorder traversal with an explicit stack of children ranges
+  typedef std::list<std::pair<char, node*>>::const_iterator child;
+  std::vector<std::pair<child, child>> stack;
+
+  for (const int index : root->indices) visit(index);
+  stack.emplace_back(root->nodes.begin(), root->nodes.end());
+  while (!stack.empty()) {
+    std::pair<child, child>& top = stack.back();
+    if (top.first == top.second) {
+      stack.pop_back();
+      continue;
+    }
+
+    node const* x = (top.first++)->second;
+    for (const int index : x->indices) visit(index);
+    stack.emplace_back(x->nodes.begin(), x->nodes.end());
+  }
+}